@@ -56,6 +56,11 @@ protected:
 	std::default_random_engine engine;
 };
 
+/**
+ * the placement rules of hw1, from the shared engine (see engine/environment.h)
+ */
+typedef variant::hw1::environment environment;
+
 /**
  * random environment
  * add a new random tile to an empty cell
@@ -68,47 +73,10 @@ public:
 		space({ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 }), popup(0, 9) {}
 
 	virtual action take_action(const board& after) {
-		//printf("op=%d\n", operation);
-		/**********
-		printf("environment\n");
-		for (int r = 0; r < 4; r++) {
-			for (int c = 0; c < 4; c++) {
-				printf("%d ", after[r][c]);
-			}
-			printf("\n");
-		}
-		**********/
-		if (bag.empty()) {
-			for (int i = 1; i <= 3; i++)
-				bag.push_back(i);
-			std::random_shuffle(bag.begin(), bag.end());
-		}
-		board::cell tile = bag.back();
-		bag.pop_back();
-
-		//printf("tile=%d\n", tile);
-		//printf("1 %d %d \n", space[0], space[15]);
-		std::vector<int> legalspace;
-		switch (operation) {
-			//case -1: legalspace = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15}; break;
-			case 0: legalspace = {12, 13, 14, 15}; break;
-			case 1: legalspace = {0, 4, 8, 12}; break;
-			case 2: legalspace = {0, 1, 2, 3}; break;
-			case 3: legalspace = {3, 7, 11, 15}; break;
-			default: legalspace = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
-
-		}
-
-		std::shuffle(legalspace.begin(), legalspace.end(), engine);
-		//for (int pos : legalspace)
-		//	printf("%d ", pos);
-		//printf("\n");
-		for (int pos : legalspace) {
-			if (after(pos) != 0) continue;
-			//board::cell tile = popup(engine) ? 1 : 2;
-			return action::place(pos, tile);
-		}
-		return action();
+		unsigned pos;
+		board::cell tile;
+		if (!environment::spawn(after, operation, bag, engine, pos, tile)) return action();
+		return action::place(pos, tile);
 	}
 
 private:
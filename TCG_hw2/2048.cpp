@@ -9,22 +9,31 @@
 #include <iostream>
 #include <fstream>
 #include <iterator>
+#include <sstream>
+#include <cstdlib>
 #include <string>
 #include "board.h"
 #include "action.h"
 #include "agent.h"
 #include "episode.h"
 #include "statistic.h"
+#include "counter.h"
+#include "server.h"
+#include "perft.h"
+#include "batch.h"
+#include "interleave.h"
+#include "query.h"
+#include "replay.h"
+#include "compare.h"
+#include "sprt.h"
 
 int main(int argc, const char* argv[]) {
-    std::cout << "2048-Demo: ";
-    std::copy(argv, argv + argc, std::ostream_iterator<const char*>(std::cout, " "));
-    std::cout << std::endl << std::endl;
-
     size_t total = 1000, block = 0, limit = 0;
     std::string play_args, evil_args;
-    std::string load, save;
+    std::string load, save, metric;
+    std::string serve, enumerate, lockstep, overlap, search, paired, test;
     bool summary = false;
+    std::string counters;
     for (int i = 1; i < argc; i++) {
         std::string para(argv[i]);
         if (para.find("--total=") == 0) {
@@ -41,22 +50,133 @@ int main(int argc, const char* argv[]) {
             load = para.substr(para.find("=") + 1);
         } else if (para.find("--save=") == 0) {
             save = para.substr(para.find("=") + 1);
+        } else if (para.find("--export=") == 0) {
+            metric = para.substr(para.find("=") + 1);
+        } else if (para.find("--serve") == 0) {
+            serve = para.find("=") != std::string::npos ? para.substr(para.find("=") + 1) : "-";
+        } else if (para.find("--perft") == 0) {
+            enumerate = para.find("=") != std::string::npos ? para.substr(para.find("=") + 1) : " ";
+        } else if (para.find("--batch") == 0) {
+            lockstep = para.find("=") != std::string::npos ? para.substr(para.find("=") + 1) : " ";
+        } else if (para.find("--interleave") == 0) {
+            overlap = para.find("=") != std::string::npos ? para.substr(para.find("=") + 1) : " ";
+        } else if (para.find("--query") == 0) {
+            search = para.find("=") != std::string::npos ? para.substr(para.find("=") + 1) : " ";
+        } else if (para.find("--compare=") == 0) {
+            paired = para.substr(para.find("=") + 1);
+        } else if (para.find("--sprt=") == 0) {
+            test = para.substr(para.find("=") + 1);
         } else if (para.find("--summary") == 0) {
             summary = true;
+        } else if (para.find("--counter") == 0) {
+            counters = para.find("=") != std::string::npos ? para.substr(para.find("=") + 1) : "text";
         }
     }
 
+    std::ostream& log = (serve == "-") ? std::cerr : std::cout;
+    log << "2048-Demo: ";
+    std::copy(argv, argv + argc, std::ostream_iterator<const char*>(log, " "));
+    log << std::endl << std::endl;
+
+    if (enumerate.size()) {
+        perft(enumerate).run();
+        return 0;
+    }
+
+    if (search.size()) {
+        if (load.empty()) {
+            std::cerr << "--query needs a saved log, e.g. --load=stat.txt --query=\"" << search << "\"" << std::endl;
+            return -1;
+        }
+        query log(load);
+        if (!log.open()) return -1;
+        log.run(search);
+        return 0;
+    }
+
+    if (save.size() && !summary && !limit) limit = block; // the file has the records, hold a block (the run without --block)
     statistic stat(total, block, limit);
 
     if (load.size()) {
-        std::ifstream in(load, std::ios::in);
-        in >> stat;
-        in.close();
+        if (!stat.load(load)) {
+            std::ifstream in(load, std::ios::in);
+            in >> stat;
+            in.close();
+        }
         summary |= stat.is_finished();
     }
 
-    player play(play_args);
-    rndenv evil(evil_args);
+    if (metric.size()) {
+        stat.exports(metric);
+    }
+
+    if (save.size()) {
+        stat.saves(save);
+    }
+
+    std::unique_ptr<player> owner;
+    try {
+        owner.reset(new player(play_args));
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+    player& play = *owner;
+    bool crn = false; // crn=1 or replay=... takes the environment of common random numbers (see replay.h)
+    std::stringstream evil_opts(evil_args);
+    for (std::string pair; evil_opts >> pair; ) {
+        if (pair.find("replay=") == 0) crn = true;
+        if (pair.find("crn=") == 0) crn = std::atoi(pair.substr(4).c_str()) != 0;
+    }
+    std::unique_ptr<rndenv> env;
+    try {
+        env.reset(crn ? new replayenv(evil_args) : new rndenv(evil_args));
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+    rndenv& evil = *env;
+
+    if (test.size()) {
+        try {
+            std::unique_ptr<player> other(paired.size() ? new player(paired) : nullptr);
+            sprt(play, other.get(), test, block).run(total);
+        } catch (std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+
+    if (paired.size()) {
+        try {
+            player other(paired);
+            replayenv common(evil_args);
+            compare(play, other, common, block).run(total);
+        } catch (std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return -1;
+        }
+        return 0;
+    }
+
+    if (serve.size()) {
+        server host(play);
+        if (serve == "-") host.serve(0, 1);
+        else if (!host.listen(serve)) return -1;
+        return 0;
+    }
+
+    if (lockstep.size()) {
+        batch(play, lockstep).run(total);
+        return 0;
+    }
+
+    if (overlap.size()) {
+        interleave(play, overlap).run(total);
+        return 0;
+    }
+    counter perf(counters.size()); // the perf events are opened only for --counter
 
     while (!stat.is_finished()) {
         play.open_episode("~:" + evil.name());
@@ -79,21 +199,17 @@ int main(int argc, const char* argv[]) {
             if (who.check_for_win(game.state())) break;
         }
         agent& win = game.last_turns(play, evil);
-        stat.close_episode(win.name());
-
         play.close_episode(win.name());
         evil.close_episode(win.name());
+
+        if (stat.is_block_end()) stat.annotate(play.info());
+        if (stat.is_block_end() && counters.size()) stat.annotate(perf.report(counters == "json"));
+        stat.close_episode(win.name());
     }
 
     if (summary) {
         stat.summary();
     }
 
-    if (save.size()) {
-        std::ofstream out(save, std::ios::out | std::ios::trunc);
-        out << stat;
-        out.close();
-    }
-
     return 0;
 }
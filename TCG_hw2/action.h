@@ -12,6 +12,7 @@ public:
 
     class slide; // create a sliding action with board opcode
     class place; // create a placing action with position and tile
+    class view;  // a plain action code without vtable, for compact storage
 
 public:
     virtual board::reward apply(board& b) const {
@@ -115,3 +116,17 @@ protected:
     action& reinterpret(const action* a) const { return *new (const_cast<action*>(a)) place(*a); }
     static __attribute__((constructor)) void init() { entries()[type_flag('p')] = new place; }
 };
+
+class action::view {
+public:
+    view(unsigned code = -1u) : code(code) {}
+    view(const action& a) : code(a) {}
+
+public:
+    operator unsigned() const { return code; }
+    unsigned type() const { return code & type_flag(-1u); }
+    unsigned event() const { return code & ~type(); }
+
+private:
+    unsigned code;
+};
@@ -2,36 +2,33 @@
 #include <string>
 #include <random>
 #include <sstream>
+#include <iomanip>
 #include <map>
+#include <stdexcept>
 #include <type_traits>
 #include <algorithm>
 #include "board.h"
 #include "action.h"
 #include "weight.h"
+#include "network.h"
+#include "spec.h"
+#include "checkpoint.h"
+#include "profile.h"
+#include "rng.h"
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <atomic>
+
+thread_local int operation;
+thread_local std::vector<board::cell> bag;
+
+/**
+ * the default n-tuple network of player, see network.h
+ * swap in network_8x4 for the row/column network, or pass net=... to load a spec (see spec.h)
+ */
+typedef network_4x6 tuple_network;
 
-int operation;
-std::vector<board::cell> bag;
-
-const int tuple_count = 4;
-int t_element_count[tuple_count] = {6, 6, 4, 4};
-int tuple[4][6] = { {0, 4, 8, 1, 5, 9},
-                    {1, 5, 9, 2, 6, 10},
-                    {2, 6, 10, 14},
-                    {3, 7, 11, 15}};
-
-/*
-const int tuple_count = 8;
-const int t_element_count = 4;
-int tuple[8][4] = { {0, 1, 2, 3},
-                    {4, 5, 6, 7},
-                    {8, 9, 10, 11},
-                    {12, 13, 14, 15},
-                    {0, 4, 8, 12},
-                    {1, 5, 9, 13},
-                    {2, 6, 10, 14},
-                    {3, 7, 11, 15}};
-*/
 class agent {
 public:
     agent(const std::string& args = "") {
@@ -47,6 +44,7 @@ public:
     virtual void close_episode(const std::string& flag = "") {}
     virtual action take_action(const board& b) { return action(); }
     virtual bool check_for_win(const board& b) { return false; }
+    virtual std::string info() const { return ""; } // extra line for the block output
 
 public:
     virtual std::string property(const std::string& key) const { return meta.at(key); }
@@ -65,16 +63,35 @@ protected:
     std::map<key, value> meta;
 };
 
+/**
+ * base agent for agents with randomness
+ * each episode draws from its own stream keyed by (seed, episode index),
+ * so an episode can be regenerated alone, on any thread and in any order
+ */
 class random_agent : public agent {
 public:
-    random_agent(const std::string& args = "") : agent(args) {
+    random_agent(const std::string& args = "") : agent(args), seed(0), index(0) {
         if (meta.find("seed") != meta.end())
-            engine.seed(int(meta["seed"]));
+            seed = uint64_t(meta["seed"]);
+        engine.seed(seed, index);
     }
     virtual ~random_agent() {}
 
+    virtual void open_episode(const std::string& flag = "") {
+        engine.seed(seed, index++);
+    }
+
+    /**
+     * let the next episode use the stream of the given episode index
+     */
+    void restart(size_t episode) {
+        index = episode;
+    }
+
 protected:
-    std::default_random_engine engine;
+    counter_rng engine;
+    uint64_t seed;
+    size_t index;
 };
 
 /**
@@ -82,15 +99,49 @@ protected:
  */
 class weight_agent : public agent {
 public:
-    weight_agent(const std::string& args = "") : agent(args) {
+    weight_agent(const std::string& args = "") : agent(args), signature(0), interval(0), episodes(0) {
+        if (meta.find("page") != meta.end()) // pass page=thp|huge to back the tables with huge pages
+            lazy_allocator<float>::config().page = meta["page"].value == "huge" ? lazy_allocator<float>::policy::huge
+                                                 : meta["page"].value == "thp" ? lazy_allocator<float>::policy::thp
+                                                 : lazy_allocator<float>::policy::normal;
+        if (meta.find("node") != meta.end()) // pass node=... to bind the tables to a numa node
+            lazy_allocator<float>::config().node = int(meta["node"]);
         if (meta.find("init") != meta.end()) // pass init=... to initialize the weight
             init_weights(meta["init"]);
         if (meta.find("load") != meta.end()) // pass load=... to load from a specific file
             load_weights(meta["load"]);
+        if (meta.find("checkpoint") != meta.end()) // pass checkpoint=... to save every ... episodes in background
+            interval = size_t(meta["checkpoint"]);
     }
     virtual ~weight_agent() {
-        if (meta.find("save") != meta.end()) // pass save=... to save to a specific file
-            save_weights(meta["save"]);
+        snapshot.wait();
+        if (meta.find("save") != meta.end()) { // pass save=... to save to a specific file
+            try {
+                page_in(0, net.size());
+                save_weights(meta["save"]);
+            } catch (std::exception& e) {
+                std::cerr << e.what() << std::endl;
+            }
+        }
+    }
+
+    virtual void close_episode(const std::string& flag = "") {
+        if (interval && ++episodes % interval == 0 && meta.find("save") != meta.end()) {
+            page_in(0, net.size());
+            snapshot.save(net, signature, meta["save"]);
+        }
+    }
+    virtual std::string info() const {
+        std::stringstream ss;
+        if (interval) ss << snapshot.info();
+        for (size_t i = 0; i < net.size(); i++) { // the occupancy of the hashed tables
+            if (!net[i].hashed()) continue;
+            if (ss.tellp() > 0) ss << ", ";
+            ss << "table " << i << " = " << std::fixed << std::setprecision(1)
+               << (100.0 * net[i].entries() / net[i].capacity()) << "% of " << net[i].capacity()
+               << " (" << net[i].evictions() << " evicted)";
+        }
+        return ss.str();
     }
 
 protected:
@@ -107,24 +158,80 @@ protected:
     }
     virtual void load_weights(const std::string& path) {
         std::ifstream in(path, std::ios::in | std::ios::binary);
-        if (!in.is_open()) std::exit(-1);
+        if (!in.is_open()) fail("cannot open weights " + path);
         uint32_t size;
         in.read(reinterpret_cast<char*>(&size), sizeof(size));
-        net.resize(size);
-        for (weight& w : net) in >> w;
+        if (size & signed_flag) in.read(reinterpret_cast<char*>(&signature), sizeof(signature));
+        net.resize(size & ~signed_flag);
+        if (meta.find("lazy") != meta.end()) { // pass lazy=1 to read the tables on first use (see page_in)
+            for (weight& w : net) {
+                uint64_t len = 0, buckets = 0;
+                offset.push_back(in.tellg());
+                in.read(reinterpret_cast<char*>(&len), sizeof(len));
+                if (weight::is_hashed(len)) in.read(reinterpret_cast<char*>(&buckets), sizeof(buckets));
+                w = buckets ? weight(len & ~(1ull << 63), buckets * 4) : weight(len);
+                in.seekg(w.raw_size(), std::ios::cur);
+            }
+            source = path;
+            paged.reset(new std::once_flag[net.size()]);
+            ready.reset(new std::atomic<bool>[net.size()]());
+        } else {
+            for (weight& w : net) in >> w;
+        }
         in.close();
     }
+    /**
+     * read the tables [first, last) of a lazily loaded file, if they are not read yet
+     * since a table section is located by its offset, a stage can be read alone
+     * each table is read once behind its own flag, so the threads sharing the agent
+     * (e.g. interleave and sprt) wait for a table being read instead of racing on it
+     */
+    void page_in(size_t first, size_t last) const {
+        for (size_t i = first; i < last && i < offset.size(); i++) {
+            if (ready[i].load(std::memory_order_acquire)) continue;
+            std::call_once(paged[i], [this, i]() {
+                std::ifstream in(source, std::ios::in | std::ios::binary);
+                in.seekg(offset[i]);
+                in >> net[i];
+                ready[i].store(true, std::memory_order_release);
+            });
+        }
+    }
+    /**
+     * the file is the number of tables and the tables (see weight), where the number has its top bit set
+     * if it is followed by the signature of the network (see tuple_net::signature);
+     * the files without a signature are still read, but cannot be checked against the network
+     */
     virtual void save_weights(const std::string& path) {
         std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
-        if (!out.is_open()) std::exit(-1);
-        uint32_t size = net.size();
+        if (!out.is_open()) throw std::runtime_error("cannot open " + path);
+        uint32_t size = net.size() | (signature ? signed_flag : 0);
         out.write(reinterpret_cast<char*>(&size), sizeof(size));
+        if (signature) out.write(reinterpret_cast<char*>(&signature), sizeof(signature));
         for (weight& w : net) out << w;
         out.close();
     }
 
+    /**
+     * abort the construction with an error, e.g. for weights that cannot be read or do not match;
+     * the tables are then left unsaved, since the destructor would save whatever is held
+     */
+    [[noreturn]] void fail(const std::string& what) {
+        meta.erase("save");
+        throw std::invalid_argument(what);
+    }
+
 protected:
-    std::vector<weight> net;
+    static constexpr uint32_t signed_flag = 1u << 31;
+    mutable std::vector<weight> net; // mutable only for page_in, behind the flags of paged
+    uint64_t signature; // of the network of the tables, 0 if unknown
+    std::vector<std::streamoff> offset;
+    mutable std::unique_ptr<std::once_flag[]> paged;
+    mutable std::unique_ptr<std::atomic<bool>[]> ready; // whether a table is read, checked before its flag
+    std::string source;
+    checkpoint snapshot;
+    size_t interval;
+    size_t episodes;
 };
 
 /**
@@ -142,6 +249,11 @@ protected:
     float alpha;
 };
 
+/**
+ * the placement rules of hw2, from the shared engine (see engine/environment.h)
+ */
+typedef variant::hw2::environment environment;
+
 /**
  * random environment
  * add a new random tile to an empty cell
@@ -153,31 +265,16 @@ public:
     rndenv(const std::string& args = "") : random_agent("name=random role=environment " + args),
         space({ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 }), popup(0, 9) {}
 
-    virtual action take_action(const board& after) {
-        if (bag.empty()) {
-            for (int i = 1; i <= 3; i++)
-                bag.push_back(i);
-            std::random_shuffle(bag.begin(), bag.end());
-        }
-        board::cell tile = bag.back();
-        bag.pop_back();
-
-        std::vector<int> legalspace;
-        switch (operation) {
-            case 0: legalspace = {12, 13, 14, 15}; break;
-            case 1: legalspace = {0, 4, 8, 12}; break;
-            case 2: legalspace = {0, 1, 2, 3}; break;
-            case 3: legalspace = {3, 7, 11, 15}; break;
-            default: legalspace = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
-        }
+    virtual void open_episode(const std::string& flag = "") {
+        random_agent::open_episode(flag);
+        bag.clear();
+    }
 
-        std::shuffle(legalspace.begin(), legalspace.end(), engine);
-        
-        for (int pos : legalspace) {
-            if (after(pos) != 0) continue;
-            return action::place(pos, tile);
-        }
-        return action();
+    virtual action take_action(const board& after) {
+        unsigned pos;
+        board::cell tile;
+        if (!environment::spawn(after, operation, bag, engine, pos, tile)) return action();
+        return action::place(pos, tile);
     }
 
 private:
@@ -192,92 +289,183 @@ private:
 class player : public weight_agent {
 public:
     player(const std::string& args = "") : weight_agent("name=dummy role=player " + args),
-        opcode({ 0, 1, 2, 3 }) {
-            for (int i=0; i<8; i++) {
-                net.emplace_back(weight(15*15*15*15*15*15*15));
+        opcode({ 0, 1, 2, 3 }), tables(0), big(0), games(0) {
+            try {
+                if (meta.find("net") != meta.end()) // pass net=... to use the network of a spec file
+                    shape.reset(new spec_net(meta["net"]));
+                else
+                    shape.reset(new static_net<tuple_network>());
+            } catch (std::exception& e) {
+                fail(e.what());
+            }
+            if (meta.find("stage") != meta.end()) // pass stage=... to select tables by game phase (see stage_of)
+                init_stages(meta["stage"]);
+            if (meta.find("schedule") != meta.end()) // pass schedule=... to train the stages one by one (see trainable)
+                init_schedule(meta["schedule"]);
+            tables = shape->sizes().size();
+            if (net.empty()) {
+                for (size_t s = 0; s <= bound.size(); s++)
+                    for (size_t i = 0; i < tables; i++) net.emplace_back(shape->sizes()[i], shape->capacities()[i]);
+            } else if (shape->verify(net, bound.size() + 1).size()) {
+                fail("mismatched weights: " + shape->verify(net, bound.size() + 1));
+            } else if (signature && signature != shape->signature()) {
+                fail("mismatched weights: the tables are indexed by the patterns of another network");
             }
+            signature = shape->signature();
+            if (meta.find("profile") != meta.end()) // pass profile=n to sample 1 in n lookups, and heatmap=... to dump them (see profile.h)
+                prof.reset(new profiler(*shape, bound.size() + 1, size_t(meta["profile"]),
+                                        meta.find("heatmap") != meta.end() ? meta["heatmap"].value : ""));
+            index.reset(new tuple_index(*shape));
+            previous = next = current = features(index.get());
+            after.fill(features(index.get()));
         }
 
-    unsigned encode(const board& state, int i) const {
-        int* t = tuple[i];
-        switch (i) {
-            case 0: case 1:
-                return (state(t[0]) << 0) | (state(t[1]) << 4) | (state(t[2]) << 8) | (state(t[3]) << 12) | (state(t[4]) << 16) | (state(t[5]) << 20);
-            default:
-                return (state(t[0]) << 0) | (state(t[1]) << 4) | (state(t[2]) << 8) | (state(t[3]) << 12);
-        }
+    float get_board_value(const board& state) const {
+        COUNT(evaluate, 1);
+        COUNT(touch, shape->lookups() * sizeof(float));
+        if (prof) observe(stage_of(state), state, nullptr, false);
+        return shape->estimate(stage(stage_of(state)), state);
+    }
+    float get_board_value(const features& state) const {
+        COUNT(evaluate, 1);
+        COUNT(touch, shape->lookups() * sizeof(float));
+        const weight* w = stage(stage_of(state.board_state()));
+        if (prof) observe(stage_of(state.board_state()), state.board_state(), state.indexed() ? state.data() : nullptr, false);
+        return state.indexed() ? shape->estimate(w, state.data()) : shape->estimate(w, state.board_state());
     }
 
-    void reflect_tuple(int i) const {
-        int reflect[16] = { 3, 2, 1, 0,
-                            7, 6, 5, 4, 
-                            11, 10, 9, 8, 
-                            15, 14, 13, 12};
-        for (int j = 0; j < t_element_count[i]; j++) 
-            tuple[i][j] = reflect[ tuple[i][j] ];
+    void train_weight(board::reward reward) {
+        double alpha = 0.003125;
+        double v_s = alpha * (get_board_value(next) - get_board_value(previous) + reward);
+        if (reward == -1) v_s = alpha * (-get_board_value(previous));
+        size_t s = stage_of(previous.board_state());
+        if (!trainable(s)) return;
+        COUNT(update, shape->lookups());
+        COUNT(touch, shape->lookups() * sizeof(float));
+        weight* w = const_cast<weight*>(stage(s));
+        if (prof) observe(s, previous.board_state(), previous.indexed() ? previous.data() : nullptr, true);
+        if (previous.indexed()) shape->update(w, previous.data(), v_s);
+        else shape->update(w, previous.board_state(), v_s);
     }
 
-    void rotate_tuple(int i) const {
-        int rotate[16] = {  3, 7, 11, 15,
-                            2, 6, 10, 14, 
-                            1, 5, 9, 13, 
-                            0, 4, 8, 12};
-        for (int j = 0; j < t_element_count[i]; j++)
-            tuple[i][j] = rotate[ tuple[i][j] ];
+    virtual void open_episode(const std::string& flag = "") {
+        count = 0;
+        games++;
+    }
+    virtual std::string info() const {
+        std::string line = weight_agent::info();
+        if (prof) line += (line.size() ? "\n" : "") + prof->report();
+        return line;
     }
 
-    float get_board_value(const board& state) const {
-        float v = 0;
-        for (int i = 0; i < tuple_count; i++) {
-            for (int rf = 0; rf < 2; rf++) {
-                reflect_tuple(i);
-                for (int rt = 0; rt < 4; rt++) {
-                    rotate_tuple(i);
-                    v += net[i][encode(state, i)];
-                }
-            }
+    /**
+     * the stage of a board, given by stage=rule:b1,b2,...
+     * the key of a board is compared with the ascending bounds, and the stage is the number of bounds <= key
+     *  stage=max:9,11  the key is the largest tile index, i.e., stage 0 below tile 9, stage 1 in [9, 11), stage 2 otherwise
+     *  stage=big9:1,3  the key is the number of tiles with index >= 9
+     * each stage has its own copy of the tables, stored as its own section of the weights file
+     * (stage s holds the tables [s * n, (s + 1) * n) for a network of n tables)
+     */
+    size_t stage_of(const board& state) const {
+        if (bound.empty()) return 0;
+        unsigned key = 0;
+        for (int i = 0; i < 16; i++) {
+            if (big) key += (state(i) >= big);
+            else key = std::max<unsigned>(key, state(i));
         }
-        return v;
+        return std::upper_bound(bound.begin(), bound.end(), key) - bound.begin();
     }
 
-    void train_weight(board::reward reward) {
-        double alpha = 0.003125;
-        double v_s = alpha * (get_board_value(next) - get_board_value(previous) + reward);
-        if (reward == -1) v_s = alpha * (-get_board_value(previous));
-        for (int i = 0; i < tuple_count; i++) {
-            for (int rf = 0; rf < 2; rf++) {
-                reflect_tuple(i);
-                for (int rt = 0; rt < 4; rt++) {
-                    rotate_tuple(i);
-                    net[i][encode(previous, i)] += v_s;
-                }
-            }
+    /**
+     * whether the tables of stage s are updated in the current episode, given by schedule=s1:n1,s2:n2,...
+     * stage s1 is trained in the first n1 episodes, then stage s2 in the next n2 episodes, and so on;
+     * the stages not being trained still evaluate the boards of their phase
+     * all stages are trained if no schedule is given, and none is trained after the schedule ends
+     */
+    bool trainable(size_t s) const {
+        if (plan.empty()) return true;
+        size_t n = games;
+        for (const auto& step : plan) {
+            if (n <= step.second) return step.first == s;
+            n -= step.second;
         }
+        return false;
     }
 
-    virtual void open_episode(const std::string& flag = "") {
-        count = 0;
+    /**
+     * the values of n packed after-states (see board::pack), for batch evaluation
+     */
+    void get_board_value(const uint64_t* state, size_t n, float* value) const {
+        COUNT(evaluate, n);
+        COUNT(touch, n * shape->lookups() * sizeof(float));
+        if (bound.empty()) {
+            shape->estimate(stage(0), state, n, value);
+            return;
+        }
+        for (size_t i = 0; i < n; i++) shape->estimate(stage(stage_of(board::unpack(state[i]))), state + i, 1, value + i);
     }
 
+    /**
+     * start loading the weights of the after-states of the expanded board, see interleave.h
+     */
+    void prefetch(const board::moves& moves) const {
+        for (int op = 0; op < 4; op++) {
+            if (!(moves.legal & (1u << op))) continue;
+            shape->prefetch(stage(stage_of(moves.after[op])), moves.after[op]);
+        }
+    }
+
+    /**
+     * the greedy move of the expanded board, or -1 if there is no legal move
+     * the value (reward + after-state value) of the move is stored to value if given
+     */
+    int select(const board::moves& moves, float* value = nullptr) const {
+        float estimate[4] = {}; // only the legal ones are read, but the compiler cannot tell once the lookups are inlined
+        for (int op = 0; op < 4; op++)
+            if (moves.legal & (1u << op)) estimate[op] = get_board_value(moves.after[op]);
+        return choose(moves, estimate, value);
+    }
+    /**
+     * the greedy moves of n expanded boards as select, with the after-states evaluated in one batch
+     */
+    void select(const board::moves* moves, size_t n, int* op, float* value) const {
+        std::vector<uint64_t> state;
+        for (size_t i = 0; i < n; i++)
+            for (int o = 0; o < 4; o++)
+                if (moves[i].legal & (1u << o)) state.push_back(moves[i].after[o].pack());
+        std::vector<float> result(state.size());
+        get_board_value(state.data(), state.size(), result.data());
+        const float* next = result.data();
+        for (size_t i = 0; i < n; i++) {
+            float estimate[4] = {};
+            for (int o = 0; o < 4; o++)
+                if (moves[i].legal & (1u << o)) estimate[o] = *(next++);
+            op[i] = choose(moves[i], estimate, value + i);
+        }
+    }
+
+    /**
+     * the after-states are evaluated from the feature indices of the board before,
+     * patched with the cells changed by the placement and each slide (see features)
+     */
     virtual action take_action(const board& before) {
-        float bestvalue = -999999999;
-        int bestop = -1;
+        COUNT(node, 1);
+        board::moves moves = before.expand();
+        current = previous;
+        current.assign(before);
+        float estimate[4];
         for (int op = 0; op < 4; op++) {
-            board temp = before;
-            board::reward reward = temp.slide(op);
-            float value = get_board_value(temp);
-            if (bestop == -1 && reward != -1)
-                bestop = op;
-            if (reward + value > bestvalue && reward != -1) {
-                bestvalue = reward + value;
-                bestop = op;
-            }
+            if (!(moves.legal & (1u << op))) continue;
+            after[op] = current;
+            after[op].assign(moves.after[op]);
+            estimate[op] = get_board_value(after[op]);
         }
+        int bestop = choose(moves, estimate);
         if (bestop != -1) {
-            next = before;
-            board::reward reward = next.slide(bestop);
+            std::swap(next, after[bestop]);
+            board::reward reward = moves.score[bestop];
             if (count) train_weight(reward);
-            previous = next;
+            std::swap(previous, next);
             count++;
             return action::slide(operation = bestop);
         } else {
@@ -286,9 +474,84 @@ public:
         }
     }
 
+protected:
+    /**
+     * the tables of stage s, read from the file on first use if lazy=1
+     */
+    const weight* stage(size_t s) const {
+        if (offset.size()) page_in(s * tables, (s + 1) * tables);
+        return net.data() + s * tables;
+    }
+
+    /**
+     * count a sampled lookup of the tables of stage s, by the feature indices or the board (see profiler)
+     */
+    void observe(size_t s, const board& state, const size_t* index, bool update) const {
+        if (!prof->sample()) return;
+        thread_local std::vector<size_t> buffer;
+        if (!index) {
+            buffer.resize(shape->lookups());
+            shape->encode(state, buffer.data());
+            index = buffer.data();
+        }
+        prof->record(s, stage(s), index, update);
+    }
+
+    void init_stages(const std::string& rule) {
+        std::string key = rule.substr(0, rule.find(':'));
+        std::stringstream ss(rule.substr(rule.find(':') + 1));
+        if (key != "max" && (key.find("big") != 0 || key.size() <= 3)) fail("unknown stage rule: " + rule);
+        try {
+            big = key == "max" ? 0 : std::stoul(key.substr(3));
+            for (std::string b; std::getline(ss, b, ','); ) bound.push_back(std::stoul(b));
+        } catch (std::logic_error&) { // from stoul
+            fail("invalid stage rule: " + rule);
+        }
+        std::sort(bound.begin(), bound.end());
+    }
+    /**
+     * the greedy move given the after-state values of the legal slides
+     */
+    int choose(const board::moves& moves, const float* estimate, float* value = nullptr) const {
+        float bestvalue = -999999999;
+        int bestop = -1;
+        for (int op = 0; op < 4; op++) {
+            if (!(moves.legal & (1u << op))) continue;
+            board::reward reward = moves.score[op];
+            if (bestop == -1)
+                bestop = op;
+            if (reward + estimate[op] > bestvalue) {
+                bestvalue = reward + estimate[op];
+                bestop = op;
+            }
+        }
+        if (value) *value = bestop != -1 ? bestvalue : 0;
+        return bestop;
+    }
+
+    void init_schedule(const std::string& list) {
+        std::stringstream ss(list);
+        try {
+            for (std::string step; std::getline(ss, step, ','); )
+                plan.emplace_back(std::stoul(step.substr(0, step.find(':'))), std::stoull(step.substr(step.find(':') + 1)));
+        } catch (std::logic_error&) { // from stoul
+            fail("invalid schedule: " + list);
+        }
+    }
+
 private:
     std::array<int, 4> opcode;
-    board previous;
-    board next;
+    std::unique_ptr<tuple_net> shape;
+    size_t tables;
+    std::vector<unsigned> bound;
+    unsigned big;
+    std::vector<std::pair<size_t, size_t>> plan;
+    size_t games;
+    std::unique_ptr<tuple_index> index;
+    std::unique_ptr<profiler> prof;
+    features previous;
+    features next;
+    features current;
+    std::array<features, 4> after;
     int count;
 };
@@ -0,0 +1,95 @@
+#pragma once
+#include <cstdlib>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <new>
+#include <utility>
+#include <string>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+/**
+ * allocator for large weight tables
+ *
+ * the storage is mapped by anonymous mmap, so the zero pages are faulted in lazily
+ * on the first write instead of being filled eagerly on construction;
+ * value-initialization only writes the elements that are not zero already, which is
+ * none on fresh storage, and the stale ones when a container regrows within its capacity
+ *
+ * the page policy is shared by all tables, and should be set before they are created
+ *   page = thp      advise transparent huge pages
+ *   page = huge     map explicit 2 MB huge pages (falls back to thp if not enough are free)
+ *   node = n        bind the memory to numa node n
+ */
+template<typename T>
+class lazy_allocator {
+public:
+    typedef T value_type;
+
+    struct policy {
+        enum { normal, thp, huge } page;
+        int node;
+        policy() : page(normal), node(-1) {}
+    };
+    static policy& config() { static policy p; return p; }
+
+public:
+    lazy_allocator() {}
+    template<typename U> lazy_allocator(const lazy_allocator<U>&) {}
+
+    T* allocate(size_t n) {
+        size_t len = n * sizeof(T);
+        if (len < threshold) {
+            void* p = std::calloc(n, sizeof(T));
+            if (!p) throw std::bad_alloc();
+            return static_cast<T*>(p);
+        }
+        void* p = MAP_FAILED;
+        if (config().page == policy::huge) // reserved, so mmap fails instead of the first touch if the pool is short
+            p = ::mmap(nullptr, align(len), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p == MAP_FAILED) {
+            p = ::mmap(nullptr, align(len), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+            if (p == MAP_FAILED) throw std::bad_alloc();
+            if (config().page != policy::normal) ::madvise(p, align(len), MADV_HUGEPAGE);
+        }
+        if (config().node >= 0) bind(p, align(len), config().node);
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_t n) {
+        size_t len = n * sizeof(T);
+        if (len < threshold) std::free(p);
+        else ::munmap(p, align(len));
+    }
+
+    template<typename U> void construct(U* p) {
+        static const U zero = U();
+        if (!std::is_trivial<U>::value || std::memcmp(p, &zero, sizeof(U))) ::new((void*) p) U();
+    }
+    template<typename U, typename... args> void construct(U* p, args&&... v) { ::new((void*) p) U(std::forward<args>(v)...); }
+
+    template<typename U> struct rebind { typedef lazy_allocator<U> other; };
+    template<typename U> bool operator ==(const lazy_allocator<U>&) const { return true; }
+    template<typename U> bool operator !=(const lazy_allocator<U>&) const { return false; }
+
+protected:
+    static constexpr size_t threshold = 1 << 16;
+    static constexpr size_t hugepage = 1 << 21;
+
+    static size_t align(size_t len) {
+        return (len + hugepage - 1) & ~(hugepage - 1);
+    }
+
+    /**
+     * mbind(2) with MPOL_BIND, called directly to avoid a dependency on libnuma
+     */
+    static void bind(void* p, size_t len, int node) {
+        const int mpol_bind = 2;
+        unsigned long mask[16] = { 0 };
+        if (node >= int(sizeof(mask) * 8)) return;
+        mask[node / (sizeof(long) * 8)] |= 1ul << (node % (sizeof(long) * 8));
+        ::syscall(SYS_mbind, p, len, mpol_bind, mask, sizeof(mask) * 8, 0);
+    }
+};
@@ -0,0 +1,196 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+/**
+ * block-compressed container of episode logs, selected by the extension '.cz' of the save file
+ *
+ * the file begins with the signature "TCGCZ1\n", followed by the blocks, each of
+ *   uint32 raw size, uint32 packed size, uint32 lines, uint32 checksum (fnv-1a of the raw bytes),
+ *   and the packed bytes
+ * a block holds whole lines (episodes) and is compressed on its own (see compress),
+ * so the blocks can be decoded in parallel, or individually from their offsets (see reader::index);
+ * a truncated last block, e.g. of an interrupted save, is ignored by the reader
+ */
+class archive {
+public:
+    static const char* signature() { return "TCGCZ1\n"; }
+    static size_t signature_size() { return 7; }
+
+    /**
+     * the suggested raw size of a block
+     */
+    static size_t block_size() { return 1 << 20; }
+
+    static bool named(const std::string& path) {
+        return path.size() >= 3 && path.compare(path.size() - 3, 3, ".cz") == 0;
+    }
+
+    static bool detect(const std::string& path) {
+        std::ifstream in(path, std::ios::in | std::ios::binary);
+        char magic[8] = { 0 };
+        return in.read(magic, signature_size()) && std::memcmp(magic, signature(), signature_size()) == 0;
+    }
+
+    static uint32_t checksum(const char* p, size_t n) {
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < n; i++) h = (h ^ uint8_t(p[i])) * 16777619u;
+        return h;
+    }
+
+    /**
+     * a whole block in the file format, of the given lines
+     */
+    static std::string pack(const std::string& text, size_t lines) {
+        std::string packed = compress(text.data(), text.size());
+        uint32_t head[4] = { uint32_t(text.size()), uint32_t(packed.size()), uint32_t(lines), checksum(text.data(), text.size()) };
+        return std::string(reinterpret_cast<const char*>(head), sizeof(head)) + packed;
+    }
+
+    struct block {
+        uint32_t raw, lines, check;
+        std::string packed;
+
+        /**
+         * the lines of the block, or an empty string if the block is corrupted
+         */
+        std::string unpack() const {
+            std::string text(raw, '\0');
+            decompress(packed.data(), packed.size(), &text[0], raw);
+            if (checksum(text.data(), text.size()) != check) text.clear();
+            return text;
+        }
+    };
+
+    /**
+     * sequential or random reader of the blocks
+     */
+    class reader {
+    public:
+        reader(const std::string& path) : in(path, std::ios::in | std::ios::binary) {
+            char magic[8] = { 0 };
+            if (!in.read(magic, signature_size()) || std::memcmp(magic, signature(), signature_size()) != 0)
+                in.setstate(std::ios::failbit);
+        }
+
+        bool good() const { return in.good(); }
+
+        /**
+         * read the next block, return false at the end or on a truncated block
+         */
+        bool next(block& b) {
+            uint32_t head[4];
+            if (!in.read(reinterpret_cast<char*>(head), sizeof(head))) return false;
+            b.raw = head[0];
+            b.packed.resize(head[1]);
+            b.lines = head[2];
+            b.check = head[3];
+            return bool(in.read(&b.packed[0], head[1]));
+        }
+
+        /**
+         * the file offsets of the complete blocks, found by skipping over the packed bytes
+         */
+        std::vector<uint64_t> index() {
+            std::vector<uint64_t> offsets;
+            in.clear();
+            in.seekg(0, std::ios::end);
+            uint64_t size = in.tellg();
+            uint64_t offset = signature_size();
+            for (uint32_t head[4]; in.seekg(offset) && in.read(reinterpret_cast<char*>(head), sizeof(head)); ) {
+                uint64_t next = offset + sizeof(head) + head[1];
+                if (next > size) break;
+                offsets.push_back(offset);
+                offset = next;
+            }
+            in.clear();
+            in.seekg(signature_size());
+            return offsets;
+        }
+
+        /**
+         * read the block at a file offset given by index
+         */
+        bool read(uint64_t offset, block& b) {
+            in.clear();
+            return in.seekg(offset) && next(b);
+        }
+
+    private:
+        std::ifstream in;
+    };
+
+public:
+    /**
+     * the coder of a block: a binary arithmetic coder driven by an adaptive order-2 context model,
+     * which predicts each bit of a byte from the two previous bytes and the bits seen so far
+     * the logs are mostly short tokens (#D, [4], 31, ...) in a small alphabet, on which this takes
+     * about 1/5 of the raw size, while an lz-style coder finds few long matches to exploit
+     */
+    static std::string compress(const char* src, size_t n) {
+        model m;
+        std::string out;
+        out.reserve(n / 4 + 16);
+        uint32_t x1 = 0, x2 = -1u;
+        for (size_t i = 0; i < n; i++) {
+            for (int b = 7; b >= 0; b--) {
+                unsigned bit = (uint8_t(src[i]) >> b) & 1;
+                uint32_t xmid = x1 + uint32_t((uint64_t(x2 - x1) * m.p()) >> 12);
+                bit ? (x2 = xmid) : (x1 = xmid + 1);
+                m.update(bit);
+                for (; ((x1 ^ x2) & 0xff000000) == 0; x1 <<= 8, x2 = (x2 << 8) | 255) out.push_back(char(x2 >> 24));
+            }
+        }
+        for (int k = 0; k < 4; k++, x1 <<= 8) out.push_back(char(x1 >> 24));
+        return out;
+    }
+
+    static void decompress(const char* src, size_t n, char* dst, size_t raw) {
+        model m;
+        const uint8_t* ip = reinterpret_cast<const uint8_t*>(src);
+        const uint8_t* end = ip + n;
+        uint32_t x1 = 0, x2 = -1u, x = 0;
+        for (int k = 0; k < 4; k++) x = (x << 8) | (ip < end ? *ip++ : 0);
+        for (size_t i = 0; i < raw; i++) {
+            unsigned c = 0;
+            for (int b = 7; b >= 0; b--) {
+                uint32_t xmid = x1 + uint32_t((uint64_t(x2 - x1) * m.p()) >> 12);
+                unsigned bit = x <= xmid;
+                bit ? (x2 = xmid) : (x1 = xmid + 1);
+                m.update(bit);
+                c = (c << 1) | bit;
+                for (; ((x1 ^ x2) & 0xff000000) == 0; x1 <<= 8, x2 = (x2 << 8) | 255) x = (x << 8) | (ip < end ? *ip++ : 0);
+            }
+            dst[i] = char(c);
+        }
+    }
+
+protected:
+    /**
+     * the probabilities (16 bits) of a one bit, indexed by a hash of the two previous bytes
+     * and the partial byte, which starts from 1 and shifts in the bits
+     */
+    struct model {
+        std::vector<uint16_t> prob;
+        uint32_t c0, c1, c2, idx;
+        model() : prob(1 << 20, 1 << 15), c0(1), c1(0), c2(0), idx(0) {}
+
+        uint32_t p() {
+            idx = ((((c2 << 8) | c1) * 0x2f0b4a33u >> 12) ^ c0) & (prob.size() - 1);
+            return std::min(std::max(prob[idx] >> 4, 1), 4095);
+        }
+        void update(unsigned bit) {
+            if (bit) prob[idx] += (65536 - prob[idx]) >> 4;
+            else prob[idx] -= prob[idx] >> 4;
+            c0 = (c0 << 1) | bit;
+            if (c0 < 256) return;
+            c2 = c1;
+            c1 = c0 & 255;
+            c0 = 1;
+        }
+    };
+};
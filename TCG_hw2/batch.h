@@ -0,0 +1,308 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <array>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <numeric>
+#include <algorithm>
+#include "board.h"
+#include "agent.h"
+#include "rng.h"
+
+/**
+ * games held in structure-of-arrays form: packed boards (see board::pack),
+ * bags, last slides, scores, done flags and random streams
+ *
+ * the environment follows the rules of rndenv, each game n draws from the stream keyed by (seed, n)
+ */
+class lockstep {
+public:
+    lockstep(uint64_t seed = 0) : seed(seed) {}
+
+public:
+    size_t size() const { return boards.size(); }
+
+    /**
+     * append a new game n to the end
+     */
+    void spawn(size_t n) {
+        boards.push_back(0);
+        bag.push_back(0);
+        last.push_back(-1);
+        score.push_back(0);
+        done.push_back(false);
+        rng.emplace_back();
+        reset(boards.size() - 1, n);
+    }
+
+    /**
+     * start game n at slot i, with the 9 initial tiles placed
+     */
+    void reset(size_t i, size_t n) {
+        boards[i] = 0;
+        bag[i] = 0;
+        last[i] = -1;
+        score[i] = 0;
+        done[i] = false;
+        rng[i].seed(seed, n);
+        for (int k = 0; k < 9; k++) place(i);
+    }
+
+    /**
+     * move the last game to slot i, and drop the last slot
+     */
+    void remove(size_t i) {
+        size_t k = boards.size() - 1;
+        boards[i] = boards[k], bag[i] = bag[k], last[i] = last[k];
+        score[i] = score[k], done[i] = done[k], rng[i] = rng[k];
+        boards.pop_back(), bag.pop_back(), last.pop_back();
+        score.pop_back(), done.pop_back(), rng.pop_back();
+    }
+
+    /**
+     * place a tile from the bag of game i to an empty cell on the spawn edge
+     * return false if there is no empty cell
+     */
+    bool place(size_t i) {
+        static const std::array<uint64_t, 5> edge = []() { // the spawn edges as the low bits of the nibbles
+            std::array<uint64_t, 5> e;
+            for (int op = 0; op < 5; op++) {
+                e[op] = 0;
+                for (unsigned m = environment::edge_type::mask(op < 4 ? op : -1); m; m &= m - 1)
+                    e[op] |= 1ull << (4 * __builtin_ctz(m));
+            }
+            return e;
+        }();
+        uint64_t x = boards[i];
+        uint64_t z = x | (x >> 1);
+        z |= z >> 2;
+        uint64_t empty = ~z & edge[last[i] >= 0 ? last[i] : 4];
+        if (!empty) return false;
+        unsigned left = bag[i];
+        unsigned t = environment::bag_type::draw(left, rng[i]);
+        bag[i] = left;
+        unsigned pos = nth(empty, rng[i]() % __builtin_popcountll(empty)) / 4;
+        boards[i] = x | (uint64_t(t) << (4 * pos));
+        return true;
+    }
+
+    /**
+     * slide a packed board in all four directions
+     * return the bitmask of legal opcodes, where a slide merging two 15-tiles is not legal
+     * since the 16 does not fit in a packed cell (see board::lookup)
+     */
+    static unsigned slide(uint64_t x, uint64_t* after, int* score) {
+        const auto& t = board::lookup::table().lines;
+        uint64_t y = transpose(x);
+        uint64_t left = 0, right = 0, up = 0, down = 0;
+        int sl = 0, sr = 0, su = 0, sd = 0;
+        unsigned wide = 0;
+        for (int i = 0; i < 4; i++) {
+            const auto& r = t[(x >> (16 * i)) & 0xffff];
+            const auto& c = t[(y >> (16 * i)) & 0xffff];
+            left |= uint64_t(r.line[0]) << (16 * i);
+            right |= uint64_t(r.line[1]) << (16 * i);
+            up |= uint64_t(c.line[0]) << (16 * i);
+            down |= uint64_t(c.line[1]) << (16 * i);
+            sl += r.score[0], sr += r.score[1];
+            su += c.score[0], sd += c.score[1];
+            wide |= ((r.move & 4) << 1) | ((r.move & 8) >> 2) | ((c.move & 4) >> 2) | ((c.move & 8) >> 1);
+        }
+        after[0] = transpose(up), after[1] = right, after[2] = transpose(down), after[3] = left;
+        score[0] = su, score[1] = sr, score[2] = sd, score[3] = sl;
+        unsigned legal = 0;
+        for (unsigned op = 0; op < 4; op++) legal |= (after[op] != x) << op;
+        return legal & ~wide;
+    }
+
+    /**
+     * transpose a packed board, cell (r, c) goes to (c, r)
+     */
+    static uint64_t transpose(uint64_t x) {
+        uint64_t a1 = x & 0xF0F00F0FF0F00F0Full;
+        uint64_t a2 = x & 0x0000F0F00000F0F0ull;
+        uint64_t a3 = x & 0x0F0F00000F0F0000ull;
+        uint64_t a = a1 | (a2 << 12) | (a3 >> 12);
+        uint64_t b1 = a & 0xFF00FF0000FF00FFull;
+        uint64_t b2 = a & 0x00FF00FF00000000ull;
+        uint64_t b3 = a & 0x00000000FF00FF00ull;
+        return b1 | (b2 >> 24) | (b3 << 24);
+    }
+
+    /**
+     * the position of the k-th set bit
+     */
+    static unsigned nth(uint64_t bits, unsigned k) {
+        while (k--) bits &= bits - 1;
+        return __builtin_ctzll(bits);
+    }
+
+protected:
+    uint64_t seed;
+    std::vector<uint64_t> boards;
+    std::vector<uint8_t> bag;
+    std::vector<int8_t> last;
+    std::vector<int> score;
+    std::vector<uint8_t> done;
+    std::vector<counter_rng> rng;
+};
+
+/**
+ * lockstep batch simulator for pure evaluation runs
+ *
+ * all games advance one turn (a slide of the player and a placement of the environment) at a time:
+ *  the move kernel slides all boards in all four directions with the line table,
+ *  the evaluation kernel estimates all legal after-states in one call,
+ *  the placement kernel draws the tiles and the cells with bit masks;
+ * finished games are compacted away, and new games take their slots until the total is reached
+ *
+ * the move and placement kernels are scalar loops over the games, since the line table lookups and
+ * the draws of each game do not map onto simd lanes; the gain is from the one batched evaluation,
+ * and from the games being contiguous arrays instead of objects
+ *
+ * the player is greedy with the network of player (no training)
+ *
+ * the arguments are given as 'key=value' pairs
+ *   lane=n     the number of games held at once (default 1024)
+ *   seed=n     the seed of the environment (default 0)
+ */
+class batch : public lockstep {
+public:
+    batch(const player& play, const std::string& args = "") : play(play), lanes(1024), started(0) {
+        std::stringstream ss(args);
+        for (std::string pair; ss >> pair; ) {
+            std::string key = pair.substr(0, pair.find('='));
+            std::string value = pair.substr(pair.find('=') + 1);
+            if (key == "lane") lanes = std::max(1ul, std::stoul(value));
+            else if (key == "seed") seed = std::stoull(value);
+        }
+    }
+
+public:
+    /**
+     * play total games and print the summary, e.g.
+     * 100000  avg = 318, max = 1514, games = 5214/s, turns = 813251/s (1024 lanes)
+     *         32      100%    (1.5%)
+     *         ...
+     */
+    void run(size_t total) {
+        auto start = std::chrono::steady_clock::now();
+        size_t turns = 0;
+        while (started < std::min(lanes, total)) spawn(started++);
+        while (boards.size()) {
+            turns += boards.size();
+            step(total);
+        }
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        size_t stat[64] = { 0 };
+        for (unsigned t : tile) stat[t]++;
+        int64_t sum = std::accumulate(result.begin(), result.end(), int64_t(0));
+        size_t n = std::max<size_t>(result.size(), 1);
+        std::ios ff(nullptr);
+        ff.copyfmt(std::cout);
+        std::cout << std::fixed << std::setprecision(0);
+        std::cout << result.size() << "\t";
+        std::cout << "avg = " << (sum / n) << ", ";
+        std::cout << "max = " << (result.size() ? *std::max_element(result.begin(), result.end()) : 0) << ", ";
+        std::cout << "games = " << (result.size() / sec) << "/s, ";
+        std::cout << "turns = " << (turns / sec) << "/s (" << lanes << " lanes)" << std::endl;
+        std::cout.copyfmt(ff);
+        for (size_t t = 0, c = 0; c < result.size(); c += stat[t++]) {
+            if (stat[t] == 0) continue;
+            size_t accu = std::accumulate(std::begin(stat) + t, std::end(stat), size_t(0));
+            std::cout << "\t" << ((1 << t) & -2u);
+            std::cout << "\t" << (accu * 100.0 / n) << "%";
+            std::cout << "\t" "(" << (stat[t] * 100.0 / n) << "%" ")";
+            std::cout << std::endl;
+        }
+        std::cout << std::endl;
+    }
+
+protected:
+    /**
+     * advance all games by one turn, then compact away the finished games
+     */
+    void step(size_t total) {
+        size_t n = boards.size();
+        after.resize(n * 4);
+        reward.resize(n * 4);
+        value.resize(n * 4);
+        legal.resize(n);
+        candidate.clear();
+
+        // move kernel
+        for (size_t i = 0; i < n; i++) {
+            legal[i] = slide(boards[i], &after[i * 4], &reward[i * 4]);
+            for (unsigned op = 0; op < 4; op++)
+                if (legal[i] & (1u << op)) candidate.push_back(i * 4 + op);
+        }
+
+        // evaluation kernel
+        states.resize(candidate.size());
+        for (size_t k = 0; k < candidate.size(); k++) states[k] = after[candidate[k]];
+        estimate.resize(candidate.size());
+        play.get_board_value(states.data(), states.size(), estimate.data());
+        for (size_t k = 0; k < candidate.size(); k++) value[candidate[k]] = estimate[k];
+
+        // selection and placement kernel
+        for (size_t i = 0; i < n; i++) {
+            if (!legal[i]) {
+                done[i] = true;
+                continue;
+            }
+            float best = -999999999;
+            int op = -1;
+            for (unsigned o = 0; o < 4; o++) {
+                if (!(legal[i] & (1u << o))) continue;
+                float v = reward[i * 4 + o] + value[i * 4 + o];
+                if (op == -1 || v > best) best = v, op = o;
+            }
+            boards[i] = after[i * 4 + op];
+            score[i] += reward[i * 4 + op];
+            last[i] = op;
+            done[i] = !place(i);
+        }
+
+        // compaction
+        for (size_t i = 0; i < boards.size(); ) {
+            if (!done[i]) {
+                i++;
+                continue;
+            }
+            finish(i);
+            if (started < total) {
+                reset(i, started++);
+                i++;
+            } else {
+                remove(i);
+            }
+        }
+    }
+
+    void finish(size_t i) {
+        unsigned t = 0;
+        for (int k = 0; k < 16; k++) t = std::max<unsigned>(t, (boards[i] >> (4 * k)) & 0x0f);
+        result.push_back(score[i]);
+        tile.push_back(t);
+    }
+
+private:
+    const player& play;
+    size_t lanes;
+    size_t started;
+
+    std::vector<uint64_t> after;
+    std::vector<int> reward;
+    std::vector<float> value;
+    std::vector<unsigned> legal;
+    std::vector<size_t> candidate;
+    std::vector<uint64_t> states;
+    std::vector<float> estimate;
+
+    std::vector<int> result;
+    std::vector<unsigned> tile;
+};
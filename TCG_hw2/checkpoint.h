@@ -0,0 +1,141 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include "weight.h"
+
+/**
+ * background checkpoint writer for weight tables
+ *
+ * the snapshot is taken by fork(), so the child process writes a copy-on-write
+ * image of the tables while the parent continues training;
+ * if fork() fails, the tables are copied into a second buffer instead and the
+ * buffer is written by the background thread
+ *
+ * the file is written to 'path.tmp' and then renamed to 'path',
+ * so an interrupted checkpoint never replaces the last good one
+ */
+class checkpoint {
+public:
+    checkpoint() : pause(0), elapsed(0), count(0), skip(0), mode("none"), busy(false) {}
+    ~checkpoint() { wait(); }
+
+public:
+    /**
+     * take a snapshot of the tables and write it with the signature of their network to path in background
+     * return false if the previous checkpoint is still being written
+     */
+    bool save(const std::vector<weight>& net, uint64_t signature, const std::string& path) {
+        if (busy) {
+            skip++;
+            return false;
+        }
+        wait();
+        busy = true;
+        count++;
+        std::string temp = path + ".tmp";
+        auto start = clock::now();
+        pid_t pid = fork();
+        if (pid == 0) {
+            _exit(write(net, signature, temp, path) ? 0 : 1);
+        } else if (pid > 0) {
+            mode = "fork";
+            pause = millisec(start);
+            worker = std::thread([this, pid, start]() {
+                int status = 0;
+                waitpid(pid, &status, 0);
+                if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) mode = "fail";
+                elapsed = millisec(start);
+                busy = false;
+            });
+        } else {
+            mode = "copy";
+            buffer = net;
+            pause = millisec(start);
+            worker = std::thread([this, signature, temp, path, start]() {
+                if (!write(buffer, signature, temp, path)) mode = "fail";
+                buffer.clear();
+                elapsed = millisec(start);
+                busy = false;
+            });
+        }
+        return true;
+    }
+
+    /**
+     * block until the pending checkpoint (if any) is written
+     */
+    void wait() {
+        if (worker.joinable()) worker.join();
+    }
+
+    /**
+     * summary of checkpoints, e.g.
+     * 'checkpoint = 3, pause = 0.8 ms (fork), write = 2311 ms, skip = 0'
+     * where 'write' is the duration of the last finished checkpoint
+     */
+    std::string info() const {
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1);
+        ss << "checkpoint = " << count << ", ";
+        ss << "pause = " << pause << " ms (" << mode.load() << "), ";
+        ss << "write = " << std::setprecision(0) << elapsed.load() << " ms, ";
+        ss << "skip = " << skip;
+        return ss.str();
+    }
+
+protected:
+    typedef std::chrono::steady_clock clock;
+
+    static double millisec(clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+    }
+
+    /**
+     * write the tables in the format of weight_agent::save_weights
+     * only raw system calls are used, since this also runs in the forked child
+     */
+    static bool write(const std::vector<weight>& net, uint64_t signature, const std::string& temp, const std::string& path) {
+        int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        uint32_t size = net.size() | (signature ? 1u << 31 : 0);
+        bool ok = flush(fd, &size, sizeof(size));
+        if (signature) ok = ok && flush(fd, &signature, sizeof(signature));
+        for (const weight& w : net) {
+            uint64_t head[2];
+            ok = ok && flush(fd, head, sizeof(uint64_t) * w.header(head));
+            ok = ok && flush(fd, w.raw(), w.raw_size());
+        }
+        ok = (::close(fd) == 0) && ok;
+        return ok && std::rename(temp.c_str(), path.c_str()) == 0;
+    }
+
+    static bool flush(int fd, const void* data, size_t len) {
+        const char* buf = static_cast<const char*>(data);
+        while (len) {
+            ssize_t n = ::write(fd, buf, len);
+            if (n < 0) return false;
+            buf += n;
+            len -= n;
+        }
+        return true;
+    }
+
+private:
+    double pause;
+    std::atomic<double> elapsed;
+    size_t count;
+    size_t skip;
+    std::atomic<const char*> mode;
+    std::atomic<bool> busy;
+    std::vector<weight> buffer;
+    std::thread worker;
+};
@@ -0,0 +1,99 @@
+#pragma once
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cmath>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "episode.h"
+#include "replay.h"
+
+/**
+ * paired evaluation of two players on common random numbers (see replayenv)
+ *
+ * episode n of both players is played against the same environment sequence, so the score
+ * difference of a pair cancels most of the luck of the tiles, and the mean difference has a much
+ * smaller standard error than the difference of two independent means
+ *
+ * every block, the output would be
+ * 1000   a = 857, b = 840, diff = 17 +- 12 (95%)
+ *        se = 6.1 (paired), 21.3 (independent), 12.2x fewer games
+ * where the last figure is how many times more games an independent comparison needs for the same error
+ *
+ * both players move greedily by player::select and are not trained, so they stay the same throughout
+ */
+class compare {
+public:
+    compare(const player& a, const player& b, replayenv& env, size_t block) : a(a), b(b), env(env), block(block ? block : -1ull),
+        count(0), sa(0), sb(0), saa(0), sbb(0), sd(0), sdd(0) {}
+
+    void run(size_t total) {
+        while (count < total) {
+            double x = play(a, count), y = play(b, count);
+            count++;
+            sa += x, saa += x * x;
+            sb += y, sbb += y * y;
+            sd += x - y, sdd += (x - y) * (x - y);
+            if (count % block == 0 || count == total) show();
+        }
+        double half = 1.96 * error(sd, sdd);
+        std::cout << "a" << (sd / count > half ? " > " : sd / count < -half ? " < " : " ~ ") << "b at 95%" << std::endl;
+    }
+
+protected:
+    /**
+     * play episode n greedily with the player against the environment,
+     * with the 9 opening placements and then a slide and a placement in turn, as the main loop does
+     */
+    board::reward play(const player& who, size_t n) {
+        env.restart(n);
+        env.open_episode(who.name() + ":~");
+        episode game;
+        game.open_episode(who.name() + ":" + env.name());
+        operation = -1;
+        bag.clear();
+        bool alive = true;
+        for (int i = 0; i < 9 && alive; i++) alive = game.apply_action(env.take_action(game.state()));
+        while (alive) {
+            int op = who.select(game.state().expand());
+            if (op == -1 || !game.apply_action(action::slide(operation = op))) break;
+            alive = game.apply_action(env.take_action(game.state()));
+        }
+        env.close_episode(alive ? env.name() : who.name());
+        return game.score();
+    }
+
+    /**
+     * standard error of the mean of the samples with the given sum and sum of squares
+     */
+    double error(double sum, double sq) const {
+        if (count < 2) return 0;
+        double mean = sum / count;
+        return std::sqrt(std::max(0.0, (sq - count * mean * mean) / (count - 1)) / count);
+    }
+
+    void show() const {
+        double paired = error(sd, sdd);
+        double independent = std::sqrt(error(sa, saa) * error(sa, saa) + error(sb, sbb) * error(sb, sbb));
+        std::ios ff(nullptr);
+        ff.copyfmt(std::cout);
+        std::cout << std::fixed << std::setprecision(0);
+        std::cout << count << "\t";
+        std::cout << "a = " << (sa / count) << ", ";
+        std::cout << "b = " << (sb / count) << ", ";
+        std::cout << "diff = " << (sd / count) << " +- " << (1.96 * paired) << " (95%)" << std::endl;
+        std::cout << std::setprecision(1);
+        std::cout << "\t" "se = " << paired << " (paired), " << independent << " (independent), ";
+        std::cout << (paired > 0 ? (independent * independent) / (paired * paired) : 0) << "x fewer games" << std::endl;
+        std::cout.copyfmt(ff);
+    }
+
+private:
+    const player& a;
+    const player& b;
+    replayenv& env;
+    size_t block;
+    size_t count;
+    double sa, sb, saa, sbb, sd, sdd;
+};
@@ -0,0 +1,154 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/**
+ * hot-path event counters of the engine
+ *
+ * each thread counts into its own slots with plain loads and stores,
+ * the slots of all threads are summed only when a report is made;
+ * compile with -DNOCOUNTER to remove the counting completely
+ *
+ * usage: COUNT(evaluate, 1);
+ */
+class counter {
+public:
+    enum event { move, illegal, evaluate, update, touch, node, events };
+    typedef std::array<uint64_t, events> values;
+
+    static void add(event e, uint64_t n) {
+        auto& c = local().value[e];
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    /**
+     * the sum of all threads since the program started
+     */
+    static values total() {
+        std::lock_guard<std::mutex> lock(registry().mutex);
+        values sum = registry().retired;
+        for (slots* s : registry().alive)
+            for (int e = 0; e < events; e++) sum[e] += s->value[e].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+public:
+    /**
+     * the hardware counters are opened only if wanted, i.e., if the reports are asked for
+     */
+    counter(bool hardware = true) : last(), cycle() {
+        hw[0] = hardware ? open(PERF_COUNT_HW_INSTRUCTIONS) : -1;
+        hw[1] = hardware ? open(PERF_COUNT_HW_CACHE_MISSES) : -1;
+        for (int i = 0; i < 2; i++) last_hw[i] = read(hw[i]);
+    }
+    ~counter() {
+        for (int i = 0; i < 2; i++) if (hw[i] >= 0) ::close(hw[i]);
+    }
+
+    /**
+     * report the counters since the last report, e.g.
+     * 'counter: move = 8964, illegal = 2113, evaluate = 8964, update = 18816,
+     *  touch = 14.6 MB, node = 2241, insn/node = 11260, miss/node = 48.2'
+     * the hardware counters are shown only if perf_event_open is available
+     */
+    std::string report(bool json = false) {
+        values now = total(), diff;
+        for (int e = 0; e < events; e++) diff[e] = now[e] - last[e];
+        last = now;
+        uint64_t hwd[2];
+        for (int i = 0; i < 2; i++) {
+            uint64_t v = read(hw[i]);
+            hwd[i] = v - last_hw[i];
+            last_hw[i] = v;
+        }
+        double nodes = std::max<uint64_t>(diff[node], 1);
+
+        const char* name[] = { "move", "illegal", "evaluate", "update", "touch", "node" };
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1);
+        if (json) {
+            ss << "{\"block\":" << (cycle++);
+            for (int e = 0; e < events; e++) ss << ",\"" << name[e] << "\":" << diff[e];
+            if (hw[0] >= 0) ss << ",\"insn\":" << hwd[0];
+            if (hw[1] >= 0) ss << ",\"miss\":" << hwd[1];
+            ss << "}";
+        } else {
+            ss << "counter: ";
+            for (int e = 0; e < events; e++) {
+                if (e) ss << ", ";
+                if (e == touch) ss << name[e] << " = " << (diff[e] / 1048576.0) << " MB";
+                else ss << name[e] << " = " << diff[e];
+            }
+            if (hw[0] >= 0) ss << ", insn/node = " << std::setprecision(0) << (hwd[0] / nodes);
+            if (hw[1] >= 0) ss << ", miss/node = " << std::setprecision(1) << (hwd[1] / nodes);
+        }
+        return ss.str();
+    }
+
+protected:
+    struct slots {
+        std::array<std::atomic<uint64_t>, events> value;
+        slots() {
+            for (auto& v : value) v = 0;
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            registry().alive.push_back(this);
+        }
+        ~slots() {
+            std::lock_guard<std::mutex> lock(registry().mutex);
+            for (int e = 0; e < events; e++) registry().retired[e] += value[e].load();
+            registry().alive.remove(this);
+        }
+    };
+    struct threads {
+        std::mutex mutex;
+        std::list<slots*> alive;
+        values retired;
+        threads() : retired() {}
+    };
+
+    static slots& local() { static thread_local slots s; return s; }
+    static threads& registry() { static threads r; return r; }
+
+    /**
+     * open a user-space hardware counter of this process and its future threads
+     * return -1 if perf_event_open is not available
+     */
+    static int open(uint64_t config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1;
+        return ::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    static uint64_t read(int fd) {
+        uint64_t v = 0;
+        if (fd >= 0 && ::read(fd, &v, sizeof(v)) != sizeof(v)) v = 0;
+        return v;
+    }
+
+private:
+    values last;
+    int hw[2];
+    uint64_t last_hw[2];
+    size_t cycle;
+};
+
+#ifdef NOCOUNTER
+#define COUNT(e, n) ((void) 0)
+#else
+#define COUNT(e, n) counter::add(counter::e, (n))
+#endif
@@ -6,16 +6,19 @@
 #include <sstream>
 #include <chrono>
 #include <numeric>
+#include <cstring>
 #include "board.h"
 #include "action.h"
 #include "agent.h"
 
 class statistic;
+class query;
 
 class episode {
 friend class statistic;
+friend class query;
 public:
-    episode() : ep_state(initial_state()), ep_score(0), ep_time(0) { ep_moves.reserve(10000); }
+    episode() : ep_state(initial_state()), ep_score(0), ep_time(0) {}
 
 public:
     board& state() { return ep_state; }
@@ -23,6 +26,7 @@ public:
     board::reward score() const { return ep_score; }
 
     void open_episode(const std::string& tag) {
+        ep_moves.reserve(10000); // only the played episodes, the parsed ones are sized by their records
         ep_open = { tag, millisec() };
     }
     void close_episode(const std::string& tag) {
@@ -59,10 +63,10 @@ public:
         size_t i = 2;
         switch (who) {
         case action::place::type:
-            if (ep_moves.size()) time += ep_moves[0].time, i = 1;
+            if (ep_moves.size()) time += ep_moves[0].time(), i = 1;
             // no break;
         case action::slide::type:
-            while (i < ep_moves.size()) time += ep_moves[i].time, i += 2;
+            while (i < ep_moves.size()) time += ep_moves[i].time(), i += 2;
             break;
         default:
             time = ep_close.when - ep_open.when;
@@ -71,6 +75,15 @@ public:
         return time;
     }
 
+    /**
+     * the board after the first k moves
+     */
+    board state_at(size_t k) const {
+        board b = initial_state();
+        for (size_t i = 0; i < k && i < ep_moves.size(); i++) action(ep_moves[i]).apply(b);
+        return b;
+    }
+
     std::vector<action> actions(unsigned who = -1u) const {
         std::vector<action> res;
         size_t i = 2;
@@ -112,38 +125,107 @@ public:
         return in;
     }
 
+    /**
+     * parse and replay an episode from the text [first, last) in the format of operator <<,
+     * with the same result as operator >> but without streams
+     * return false if the text is not an episode
+     */
+    bool parse(const char* first, const char* last) {
+        const char* mid = std::find(first, last, '|');
+        const char* end = std::find(mid == last ? last : mid + 1, last, '|');
+        if (mid == last || end == last) return false;
+        ep_state = initial_state();
+        ep_score = 0;
+        ep_time = 0;
+        ep_open = parse_meta(first, mid);
+        ep_close = parse_meta(end + 1, last);
+        std::vector<move> moves;
+        for (const char* p = mid + 1; p < end; ) {
+            unsigned code = -1u;
+            board::reward reward = -1;
+            if (p[0] == '#' && p + 1 < end && std::strchr("URDL", p[1]) && p[1]) {
+                unsigned op = std::strchr("URDL", p[1]) - "URDL";
+                code = action::slide(op);
+                reward = ep_state.slide(op);
+            } else if (p + 1 < end && tile_index(p[0]) < 16 && tile_index(p[1]) < 36) {
+                code = action::place(tile_index(p[0]), tile_index(p[1]));
+                reward = ep_state.place(tile_index(p[0]), tile_index(p[1]));
+            }
+            p += 2;
+            ep_score += reward;
+            board::reward r = 0;
+            time_t t = 0;
+            if (p < end && *p == '[') p = parse_number(p + 1, end, r) + 1;
+            if (p < end && *p == '(') p = parse_number(p + 1, end, t) + 1;
+            moves.emplace_back(action::view(code), r, t);
+        }
+        ep_moves.swap(moves);
+        return true;
+    }
+
 protected:
+    static unsigned tile_index(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'A' && c <= 'Z') return c - 'A' + 10;
+        return -1u;
+    }
+    template<typename numeric>
+    static const char* parse_number(const char* p, const char* last, numeric& v) {
+        bool neg = (p < last && *p == '-');
+        v = 0;
+        for (p += neg; p < last && *p >= '0' && *p <= '9'; p++) v = v * 10 + (*p - '0');
+        if (neg) v = -v;
+        return p;
+    }
 
+    /**
+     * a move packed into 64 bits:
+     * the action code in the low 24 bits (type in 8 bits and event in 16 bits, all ones for an invalid code),
+     * the reward in the next 20 bits (signed), and the time in the high 20 bits (millisecond, saturated)
+     */
     struct move {
-        action code;
-        board::reward reward;
-        time_t time;
-        move(action code = {}, board::reward reward = 0, time_t time = 0) : code(code), reward(reward), time(time) {}
+        uint64_t bits;
+        move(action::view code = {}, board::reward reward = 0, time_t time = 0) : bits(0) {
+            uint64_t c = code == -1u ? 0xffffff : ((code.type() >> 8) | (code.event() & 0xffff));
+            uint64_t r = uint64_t(reward) & 0xfffff;
+            uint64_t t = std::min<uint64_t>(std::max<time_t>(time, 0), 0xfffff);
+            bits = c | (r << 24) | (t << 44);
+        }
 
-        operator action() const { return code; }
+        action::view code() const {
+            unsigned c = bits & 0xffffff;
+            return c == 0xffffff ? -1u : ((c & 0xff0000) << 8) | (c & 0xffff);
+        }
+        board::reward reward() const { return int32_t(uint32_t(bits >> 24) << 12) >> 12; }
+        time_t time() const { return bits >> 44; }
+
+        operator action() const { return action(unsigned(code())); }
         friend std::ostream& operator <<(std::ostream& out, const move& m) {
-            out << m.code;
-            if (m.reward) out << '[' << std::dec << m.reward << ']';
-            if (m.time) out << '(' << std::dec << m.time << ')';
+            out << action(m);
+            if (m.reward()) out << '[' << std::dec << m.reward() << ']';
+            if (m.time()) out << '(' << std::dec << m.time() << ')';
             return out;
         }
         friend std::istream& operator >>(std::istream& in, move& m) {
-            in >> m.code;
-            m.reward = 0;
-            m.time = 0;
+            action code;
+            board::reward reward = 0;
+            time_t time = 0;
+            in >> code;
             if (in.peek() == '[') {
                 in.ignore(1);
-                in >> std::dec >> m.reward;
+                in >> std::dec >> reward;
                 in.ignore(1);
             }
             if (in.peek() == '(') {
                 in.ignore(1);
-                in >> std::dec >> m.time;
+                in >> std::dec >> time;
                 in.ignore(1);
             }
+            m = move(code, reward, time);
             return in;
         }
     };
+    static_assert(sizeof(move) == 8, "a move takes 64 bits");
 
     struct meta {
         std::string tag;
@@ -158,6 +240,13 @@ protected:
         }
     };
 
+    static meta parse_meta(const char* first, const char* last) {
+        const char* at = std::find(first, last, '@');
+        meta m(std::string(first, at), 0);
+        if (at != last) parse_number(at + 1, last, m.when);
+        return m;
+    }
+
     static board initial_state() {
         return {};
     }
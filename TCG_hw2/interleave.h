@@ -0,0 +1,162 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "board.h"
+#include "agent.h"
+#include "rng.h"
+
+/**
+ * interleaved execution of independent games, to overlap the weight lookups of one game
+ * with the work of the others
+ *
+ * each thread holds K games as state machines, and visits them in turn;
+ * a visit decides the move of the game from the after-states prefetched at its last visit,
+ * places the next tile, expands the new board, and issues the prefetches of its after-states,
+ * so the loads of a game are in flight while the other K - 1 games are visited
+ *
+ * the player is greedy with the network of player (no training),
+ * the environment follows the rules of rndenv, each game n draws from the stream keyed by (seed, n)
+ * as in batch.h, so both give the same games for the same seed
+ *
+ * the arguments are given as 'key=value' pairs
+ *   game=k     the number of games interleaved on each thread (default 8)
+ *   thread=n   the number of threads (default 1)
+ *   seed=n     the seed of the environment (default 0)
+ */
+class interleave {
+public:
+    interleave(const player& play, const std::string& args = "") : play(play), games(8), threads(1), seed(0) {
+        std::stringstream ss(args);
+        for (std::string pair; ss >> pair; ) {
+            std::string key = pair.substr(0, pair.find('='));
+            std::string value = pair.substr(pair.find('=') + 1);
+            if (key == "game") games = std::max(1ul, std::stoul(value));
+            else if (key == "thread") threads = std::max(1ul, std::stoul(value));
+            else if (key == "seed") seed = std::stoull(value);
+        }
+    }
+
+public:
+    /**
+     * play total games and print the summary, e.g.
+     * 100000  avg = 318, max = 1514, games = 2107/s, 2107/s per core (8 games x 1 threads)
+     */
+    void run(size_t total) {
+        auto start = std::chrono::steady_clock::now();
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < threads; i++) workers.emplace_back([&]() { work(next, total); });
+        for (std::thread& w : workers) w.join();
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        int64_t sum = 0;
+        for (int r : result) sum += r;
+        std::ios ff(nullptr);
+        ff.copyfmt(std::cout);
+        std::cout << std::fixed << std::setprecision(0);
+        std::cout << result.size() << "\t";
+        std::cout << "avg = " << (sum / std::max<int64_t>(result.size(), 1)) << ", ";
+        std::cout << "max = " << (result.size() ? *std::max_element(result.begin(), result.end()) : 0) << ", ";
+        std::cout << "games = " << (result.size() / sec) << "/s, ";
+        std::cout << (result.size() / sec / threads) << "/s per core";
+        std::cout << " (" << games << " games x " << threads << " threads)" << std::endl;
+        std::cout.copyfmt(ff);
+    }
+
+protected:
+    struct game {
+        board state;
+        board::moves moves;
+        unsigned bag;
+        int last;
+        int score;
+        bool live;
+        counter_rng rng;
+    };
+
+    /**
+     * the loop of a thread, visiting its games in turn until no game is left to start
+     */
+    void work(std::atomic<size_t>& next, size_t total) {
+        std::vector<game> slot(games);
+        std::vector<int> local;
+        size_t live = 0;
+        for (game& g : slot) live += (g.live = start(g, next, total));
+        while (live) {
+            for (game& g : slot) {
+                if (!g.live || visit(g)) continue;
+                local.push_back(g.score);
+                if (!(g.live = start(g, next, total))) live--;
+            }
+        }
+        std::lock_guard<std::mutex> lock(merge);
+        result.insert(result.end(), local.begin(), local.end());
+    }
+
+    /**
+     * take the next game number and set up its initial board
+     * return false if all games have been started
+     */
+    bool start(game& g, std::atomic<size_t>& next, size_t total) {
+        size_t n = next++;
+        if (n >= total) return false;
+        g.state = board();
+        g.bag = 0;
+        g.last = -1;
+        g.score = 0;
+        g.rng.seed(seed, n);
+        for (int k = 0; k < 9; k++) place(g);
+        expand(g);
+        return true;
+    }
+
+    /**
+     * advance a game by one turn, return false if the game is over
+     */
+    bool visit(game& g) {
+        int op = play.select(g.moves);
+        if (op == -1) return false;
+        g.state = g.moves.after[op];
+        g.score += g.moves.score[op];
+        g.last = op;
+        if (!place(g)) return false;
+        expand(g);
+        return true;
+    }
+
+    void expand(game& g) {
+        g.moves = g.state.expand();
+        play.prefetch(g.moves);
+    }
+
+    /**
+     * place a tile from the bag to an empty cell on the spawn edge, drawn as in batch.h
+     * return false if there is no empty cell
+     */
+    bool place(game& g) {
+        unsigned empty[16], n = 0;
+        for (unsigned m = environment::edge_type::mask(g.last); m; m &= m - 1)
+            if (g.state(__builtin_ctz(m)) == 0) empty[n++] = __builtin_ctz(m);
+        if (n == 0) return false;
+        unsigned t = environment::bag_type::draw(g.bag, g.rng);
+        g.state.place(empty[g.rng() % n], t);
+        return true;
+    }
+
+private:
+    const player& play;
+    size_t games;
+    size_t threads;
+    uint64_t seed;
+    std::mutex merge;
+    std::vector<int> result;
+};
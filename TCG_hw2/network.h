@@ -0,0 +1,442 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <sstream>
+#include <type_traits>
+#include <algorithm>
+#include <cstddef>
+#include "board.h"
+#include "weight.h"
+
+/**
+ * the position of a cell (1-d form index) under symmetry k (0-7)
+ *
+ * k = 0-3: reflected horizontally, then rotated clockwise (k + 1) % 4 times
+ * k = 4-7: rotated clockwise (k + 1) % 4 times
+ *
+ * this is the order in which the tuples were reflected and rotated in place
+ */
+constexpr unsigned reflect_cell(unsigned p) { return (p & ~3u) | (3 - (p & 3)); }
+constexpr unsigned rotate_cell(unsigned p, unsigned n) { return n ? rotate_cell((p % 4) * 4 + (3 - p / 4), n - 1) : p; }
+constexpr unsigned isomorphic_cell(unsigned p, unsigned k) { return rotate_cell(k < 4 ? reflect_cell(p) : p, (k + 1) % 4); }
+
+/**
+ * n-tuple pattern fixed at compile time, e.g. pattern<0, 4, 8, 1, 5, 9>
+ * each cell takes 4 bits of the index, the first cell is the lowest
+ */
+template<unsigned... cells>
+struct pattern {
+    static constexpr unsigned length = sizeof...(cells);
+    static constexpr size_t size = size_t(1) << (4 * length);
+
+    /**
+     * the feature index of state under symmetry k
+     * the cell positions are constants, so the encoder is a chain of loads and shifts
+     */
+    template<unsigned k, typename state>
+    static size_t encode(const state& s) { return encoder<k, 0, cells...>::get(s); }
+
+    /**
+     * the cells of the pattern under symmetry k, the first cell is the lowest
+     */
+    static std::vector<unsigned> positions(unsigned k) { return { isomorphic_cell(cells, k)... }; }
+
+protected:
+    template<unsigned k, unsigned shift, unsigned... rest>
+    struct encoder {
+        template<typename state> static size_t get(const state& s) { return 0; }
+    };
+    template<unsigned k, unsigned shift, unsigned c, unsigned... rest>
+    struct encoder<k, shift, c, rest...> {
+        template<typename state> static size_t get(const state& s) {
+            return (size_t(s(std::integral_constant<unsigned, isomorphic_cell(c, k)>::value)) << shift)
+                 | encoder<k, shift + 4, rest...>::get(s);
+        }
+    };
+};
+
+/**
+ * n-tuple network fixed at compile time, one weight table for each pattern
+ *
+ * the evaluation and update over all patterns and all 8 symmetries are
+ * expanded by recursion into straight-line code without runtime branches,
+ * the lookups are accumulated in the same order as a loop over patterns and symmetries
+ */
+template<class... patterns>
+struct network {
+    static constexpr unsigned count = 0;
+    static std::vector<size_t> sizes() { return {}; }
+    static void layout(std::vector<std::vector<unsigned>>& cells) {}
+    template<typename state> static void estimate(const weight* w, const state& s, float& v) {}
+    template<typename state> static void update(weight* w, const state& s, double u) {}
+    template<typename state> static void prefetch(const weight* w, const state& s) {}
+    template<typename state> static void encode(const state& s, size_t* index) {}
+    static void estimate(const weight* w, const size_t* index, float& v) {}
+    static void update(weight* w, const size_t* index, double u) {}
+    template<typename state> static float estimate(const std::vector<weight>& net, const state& s) { return 0; }
+    template<typename state> static void update(std::vector<weight>& net, const state& s, double u) {}
+};
+
+template<class P, class... rest>
+struct network<P, rest...> {
+    static constexpr unsigned count = 1 + sizeof...(rest);
+
+    static std::vector<size_t> sizes() {
+        std::vector<size_t> v = network<rest...>::sizes();
+        v.insert(v.begin(), size_t(P::size));
+        return v;
+    }
+
+    /**
+     * the cells of all features, in the order of estimate (8 features for each pattern)
+     */
+    static void layout(std::vector<std::vector<unsigned>>& cells) {
+        for (unsigned k = 0; k < 8; k++) cells.push_back(P::positions(k));
+        network<rest...>::layout(cells);
+    }
+
+    template<typename state> static float estimate(const std::vector<weight>& net, const state& s) {
+        float v = 0;
+        estimate(net.data(), s, v);
+        return v;
+    }
+    template<typename state> static void update(std::vector<weight>& net, const state& s, double u) {
+        update(net.data(), s, u);
+    }
+
+    template<typename state> static void estimate(const weight* w, const state& s, float& v) {
+        symmetry<0>::estimate(w[0], s, v);
+        network<rest...>::estimate(w + 1, s, v);
+    }
+    template<typename state> static void update(weight* w, const state& s, double u) {
+        symmetry<0>::update(w[0], s, u);
+        network<rest...>::update(w + 1, s, u);
+    }
+    template<typename state> static void prefetch(const weight* w, const state& s) {
+        symmetry<0>::prefetch(w[0], s);
+        network<rest...>::prefetch(w + 1, s);
+    }
+
+    /**
+     * the feature indices in the order of estimate (8 for each pattern), and the lookups of given indices
+     */
+    template<typename state> static void encode(const state& s, size_t* index) {
+        symmetry<0>::encode(s, index);
+        network<rest...>::encode(s, index + 8);
+    }
+    static void estimate(const weight* w, const size_t* index, float& v) {
+        for (unsigned k = 0; k < 8; k++) v += w[0][index[k]];
+        network<rest...>::estimate(w + 1, index + 8, v);
+    }
+    static void update(weight* w, const size_t* index, double u) {
+        for (unsigned k = 0; k < 8; k++) w[0][index[k]] += u;
+        network<rest...>::update(w + 1, index + 8, u);
+    }
+
+protected:
+    template<unsigned k, bool end = (k == 8)>
+    struct symmetry {
+        template<typename state> static void estimate(const weight& w, const state& s, float& v) {
+            v += w[P::template encode<k>(s)];
+            symmetry<k + 1>::estimate(w, s, v);
+        }
+        template<typename state> static void update(weight& w, const state& s, double u) {
+            w[P::template encode<k>(s)] += u;
+            symmetry<k + 1>::update(w, s, u);
+        }
+        template<typename state> static void prefetch(const weight& w, const state& s) {
+            __builtin_prefetch(w.data() + P::template encode<k>(s));
+            symmetry<k + 1>::prefetch(w, s);
+        }
+        template<typename state> static void encode(const state& s, size_t* index) {
+            index[k] = P::template encode<k>(s);
+            symmetry<k + 1>::encode(s, index);
+        }
+    };
+    template<unsigned k>
+    struct symmetry<k, true> {
+        template<typename state> static void estimate(const weight& w, const state& s, float& v) {}
+        template<typename state> static void update(weight& w, const state& s, double u) {}
+        template<typename state> static void prefetch(const weight& w, const state& s) {}
+        template<typename state> static void encode(const state& s, size_t* index) {}
+    };
+};
+
+/**
+ * the networks in use
+ * the 4x6-tuple network: two 6-tuples (2x3 rectangles) and two 4-tuples (columns)
+ * the 8x4-tuple network: all rows and columns
+ */
+typedef network<pattern<0, 4, 8, 1, 5, 9>,
+                pattern<1, 5, 9, 2, 6, 10>,
+                pattern<2, 6, 10, 14>,
+                pattern<3, 7, 11, 15>> network_4x6;
+typedef network<pattern<0, 1, 2, 3>,
+                pattern<4, 5, 6, 7>,
+                pattern<8, 9, 10, 11>,
+                pattern<12, 13, 14, 15>,
+                pattern<0, 4, 8, 12>,
+                pattern<1, 5, 9, 13>,
+                pattern<2, 6, 10, 14>,
+                pattern<3, 7, 11, 15>> network_8x4;
+
+/**
+ * n-tuple network interface of player, for networks chosen at runtime
+ */
+class tuple_net {
+public:
+    virtual ~tuple_net() {}
+    virtual std::vector<size_t> sizes() const = 0;
+    virtual size_t lookups() const = 0; // number of table lookups per estimate
+
+    /**
+     * the capacity of each table, 0 for a dense table, or the entries a hashed table holds (see weight)
+     * only networks which read and write through weight::find and weight::add may have hashed tables
+     */
+    virtual std::vector<size_t> capacities() const { return std::vector<size_t>(sizes().size(), 0); }
+
+    virtual float estimate(const weight* w, const board& s) const = 0;
+    virtual void update(weight* w, const board& s, double u) const = 0;
+
+    /**
+     * the cells of the features in the order of estimate, and the largest tile index of a cell;
+     * the index of feature i is the sum of min(s(cells[i][j]), clip) * (clip + 1)^j
+     */
+    struct layout_t {
+        std::vector<std::vector<unsigned>> cells;
+        unsigned clip;
+    };
+    virtual layout_t layout() const = 0;
+
+    /**
+     * the feature indices of a board (lookups() of them), and the estimate and update by given indices,
+     * for the indices kept up to date by features
+     */
+    virtual void encode(const board& s, size_t* index) const = 0;
+    virtual std::vector<size_t> owners() const = 0; // the table of each feature, in the order of encode
+    virtual float estimate(const weight* w, const size_t* index) const = 0;
+    virtual void update(weight* w, const size_t* index, double u) const = 0;
+
+    /**
+     * whether keeping the indices up to date pays off, i.e., encoding a board from scratch
+     * costs more than patching the changed cells
+     */
+    virtual bool incremental() const { return true; }
+
+    /**
+     * estimate n packed boards (see board::pack) at once
+     */
+    virtual void estimate(const weight* w, const uint64_t* s, size_t n, float* out) const {
+        for (size_t i = 0; i < n; i++) out[i] = estimate(w, board::unpack(s[i]));
+    }
+
+    /**
+     * issue the loads of the weights estimate(w, s) will read, without waiting for them
+     */
+    virtual void prefetch(const weight* w, const board& s) const {}
+
+    /**
+     * a hash of how the tables are indexed, i.e., the clip and the cells of the features of each table
+     * (sorted, so the same patterns hash the same in any network), saved along with the weights
+     * so that the weights of another network with tables of the same sizes are rejected
+     */
+    uint64_t signature() const {
+        layout_t l = layout();
+        std::vector<size_t> owner = owners();
+        std::vector<std::vector<std::vector<unsigned>>> table(sizes().size());
+        for (size_t i = 0; i < l.cells.size(); i++) table[owner[i]].push_back(l.cells[i]);
+        uint64_t h = 0xcbf29ce484222325ull; // fnv-1a over the words
+        auto mix = [&h](uint64_t v) { h = (h ^ v) * 0x100000001b3ull; };
+        mix(l.clip);
+        for (auto& t : table) {
+            std::sort(t.begin(), t.end());
+            mix(t.size());
+            for (const auto& f : t) {
+                mix(f.size());
+                for (unsigned c : f) mix(c);
+            }
+        }
+        return h | 1; // 0 stands for no signature
+    }
+
+    /**
+     * check the tables (e.g. given by load_weights) against 'stages' copies of the network
+     * return an error message, or an empty string if they match
+     */
+    std::string verify(const std::vector<weight>& net, size_t stages = 1) const {
+        std::vector<size_t> expect = sizes();
+        std::stringstream ss;
+        if (net.size() != expect.size() * stages) {
+            ss << "expect " << expect.size() * stages << " tables, but " << net.size() << " are given";
+            return ss.str();
+        }
+        std::vector<size_t> capacity = capacities();
+        for (size_t i = 0; i < net.size(); i++) {
+            if (net[i].hashed() != (capacity[i % expect.size()] > 0)) {
+                ss << "expect table " << i << " to be " << (net[i].hashed() ? "dense" : "hashed") << ", but a "
+                   << (net[i].hashed() ? "hashed" : "dense") << " one is given";
+                return ss.str();
+            }
+            if (net[i].size() == expect[i % expect.size()]) continue;
+            ss << "expect table " << i << " of size " << expect[i % expect.size()] << ", but " << net[i].size() << " is given";
+            return ss.str();
+        }
+        return "";
+    }
+};
+
+/**
+ * runtime interface of a compile-time network
+ */
+template<class N>
+class static_net : public tuple_net {
+public:
+    using tuple_net::estimate;
+    std::vector<size_t> sizes() const { return N::sizes(); }
+    size_t lookups() const { return N::count * 8; }
+    float estimate(const weight* w, const board& s) const { float v = 0; N::estimate(w, s, v); return v; }
+    void update(weight* w, const board& s, double u) const { N::update(w, s, u); }
+    void prefetch(const weight* w, const board& s) const { N::prefetch(w, s); }
+    layout_t layout() const {
+        layout_t l;
+        N::layout(l.cells);
+        l.clip = 15;
+        return l;
+    }
+    void encode(const board& s, size_t* index) const { N::encode(s, index); }
+    std::vector<size_t> owners() const {
+        std::vector<size_t> v;
+        for (size_t i = 0; i < lookups(); i++) v.push_back(i / 8);
+        return v;
+    }
+    float estimate(const weight* w, const size_t* index) const { float v = 0; N::estimate(w, index, v); return v; }
+    void update(weight* w, const size_t* index, double u) const { N::update(w, index, u); }
+
+    /**
+     * the compile-time encoders are a few loads and shifts, about as cheap as any patch
+     */
+    bool incremental() const { return false; }
+
+    /**
+     * the features are extracted from the packed boards directly
+     */
+    void estimate(const weight* w, const uint64_t* s, size_t n, float* out) const {
+        for (size_t i = 0; i < n; i++) {
+            float v = 0;
+            N::estimate(w, packed(s[i]), v);
+            out[i] = v;
+        }
+    }
+
+protected:
+    struct packed {
+        uint64_t v;
+        packed(uint64_t v) : v(v) {}
+        board::cell operator ()(unsigned i) const { return (v >> (4 * i)) & 0x0f; }
+    };
+};
+
+/**
+ * the cells of a network mapped to the features they take part in
+ *
+ * each cell keeps the list of features it takes part in, with its place value in their indices,
+ * so a change of one cell updates only the indices of those features
+ */
+class tuple_index {
+public:
+    tuple_index(const tuple_net& net) : net(net), count(net.lookups()), patch(16), cost(0) {
+        tuple_net::layout_t layout = net.layout();
+        clip = layout.clip;
+        for (size_t i = 0; i < layout.cells.size(); i++) {
+            size_t place = 1;
+            for (unsigned c : layout.cells[i]) {
+                patch[c].push_back({ i, place });
+                place *= clip + 1;
+            }
+            cost += layout.cells[i].size();
+        }
+    }
+
+public:
+    const tuple_net& network() const { return net; }
+    size_t size() const { return count; }
+    bool enabled() const { return net.incremental(); }
+
+    /**
+     * update the indices for the change of cell pos from tile a to tile b
+     */
+    void change(size_t* index, unsigned pos, board::cell a, board::cell b) const {
+        ptrdiff_t d = ptrdiff_t(std::min<board::cell>(b, clip)) - ptrdiff_t(std::min<board::cell>(a, clip));
+        if (d == 0) return;
+        for (const entry& e : patch[pos]) index[e.feature] += d * ptrdiff_t(e.place);
+    }
+
+    /**
+     * whether patching the cells in mask is cheaper than encoding from scratch,
+     * where a patch (a read-modify-write of an index) weighs as much as reading 8 cells
+     */
+    bool cheaper(unsigned mask) const {
+        size_t n = 0;
+        for (; mask; mask &= mask - 1) n += patch[__builtin_ctz(mask)].size();
+        return n * 8 < cost;
+    }
+
+private:
+    struct entry {
+        size_t feature;
+        size_t place;
+    };
+    const tuple_net& net;
+    size_t count;
+    std::vector<std::vector<entry>> patch;
+    size_t cost;
+    unsigned clip;
+};
+
+/**
+ * a board with its feature indices, kept up to date as the board changes
+ *
+ * moving to another board patches the indices of the cells that differ,
+ * e.g. a placement changes one cell, and a slide leaves the unchanged lines alone;
+ * the indices are encoded from scratch instead if too many cells differ,
+ * and only the board is kept if the network is not incremental
+ */
+class features {
+public:
+    features(const tuple_index* map = nullptr) : map(map) {
+        if (map && map->enabled()) {
+            index.resize(map->size());
+            map->network().encode(state, index.data());
+        }
+    }
+
+public:
+    const board& board_state() const { return state; }
+    const size_t* data() const { return index.data(); }
+    bool indexed() const { return index.size(); }
+
+    void assign(const board& s) {
+        if (!indexed()) {
+            state = s;
+            return;
+        }
+        unsigned diff = 0;
+        for (int i = 0; i < 16; i++) diff |= unsigned(state(i) != s(i)) << i;
+        if (!diff) return;
+        if (!map->cheaper(diff)) {
+            state = s;
+            map->network().encode(state, index.data());
+            return;
+        }
+        for (; diff; diff &= diff - 1) {
+            unsigned i = __builtin_ctz(diff);
+            map->change(index.data(), i, state(i), s(i));
+            state(i) = s(i);
+        }
+    }
+
+private:
+    const tuple_index* map;
+    board state;
+    std::vector<size_t> index;
+};
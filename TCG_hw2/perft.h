@@ -0,0 +1,224 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <array>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <unordered_set>
+#include <memory>
+#include <cstring>
+#include <cctype>
+#include "board.h"
+#include "agent.h"
+
+/**
+ * perft-style enumeration of all reachable positions, for validating and benchmarking the engine
+ *
+ * a position is the board, the tiles left in the bag, the last slide, and the step,
+ * the moves follow the rules of the main loop and rndenv:
+ *  the environment moves at step < 9 and at even steps, the player moves at the other steps
+ *  the environment draws any tile left in the bag (refilled with 1, 2, 3 when empty),
+ *  and places it at any empty cell on the edge opposite to the last slide (anywhere before the first slide)
+ *  the player makes any legal slide
+ *  a position is terminal if the side to move has no move
+ *
+ * the arguments are given as 'key=value' pairs
+ *   depth=n            the plies to enumerate (default 6)
+ *   board=...          the start board, 16 tile indices in 0-9A-F (default empty)
+ *   bag=...            the tiles left in the bag, e.g. bag=13 (default empty)
+ *   last=n             the last slide opcode, -1 if none (default -1)
+ *   step=n             the step of the start position (default 0)
+ *   thread=n           the number of threads (default all cores)
+ *   dedup=1            also count the distinct positions of each ply
+ */
+class perft {
+public:
+    perft(const std::string& args = "") : depth(6), bag(0), last(-1), step(0), dedup(false) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+        std::stringstream ss(args);
+        for (std::string pair; ss >> pair; ) {
+            std::string key = pair.substr(0, pair.find('='));
+            std::string value = pair.substr(pair.find('=') + 1);
+            if (key == "depth") depth = std::stoul(value);
+            else if (key == "board") parse(value);
+            else if (key == "bag") for (char t : value) bag |= (t >= '1' && t <= '3') ? 1 << (t - '1') : 0;
+            else if (key == "last") last = std::stoi(value);
+            else if (key == "step") step = std::stoul(value);
+            else if (key == "thread") threads = std::max(1ul, std::stoul(value));
+            else if (key == "dedup") dedup = (value != "0");
+        }
+    }
+
+public:
+    /**
+     * enumerate and print the counts of each ply, e.g.
+     * ply    nodes     play      env       terminal  distinct
+     * 0      1         0         1         0         1
+     * 1      48        0         48        0         48
+     * ...
+     * total 1234567 nodes in 0.52 s, 2374167 nodes/s (4 threads)
+     */
+    void run() {
+        tally.assign(depth + 1, counts());
+        seen.reset(dedup ? new shard[(depth + 1) * shards] : nullptr);
+        root.bag = bag;
+        root.last = last;
+        root.step = step;
+        auto start = std::chrono::steady_clock::now();
+
+        // expand breadth-first until there is enough work to share among the threads
+        std::vector<node> frontier = { root };
+        unsigned ply = 0;
+        while (ply < depth && frontier.size() < threads * 64) {
+            std::vector<node> next;
+            for (const node& n : frontier) visit(n, ply, tally, &next);
+            frontier.swap(next);
+            ply++;
+        }
+        std::atomic<size_t> cursor(0);
+        std::mutex merge;
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < threads; i++) {
+            workers.emplace_back([&]() {
+                std::vector<counts> local(depth + 1);
+                for (size_t k; (k = cursor++) < frontier.size(); ) search(frontier[k], ply, local);
+                std::lock_guard<std::mutex> lock(merge);
+                for (unsigned d = 0; d <= depth; d++) tally[d] += local[d];
+            });
+        }
+        for (std::thread& w : workers) w.join();
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        uint64_t total = 0;
+        std::cout << std::left;
+        std::cout << std::setw(7) << "ply" << std::setw(14) << "nodes" << std::setw(14) << "play";
+        std::cout << std::setw(14) << "env" << std::setw(14) << "terminal" << (dedup ? "distinct" : "") << std::endl;
+        for (unsigned d = 0; d <= depth; d++) {
+            const counts& c = tally[d];
+            std::cout << std::setw(7) << d << std::setw(14) << c.nodes << std::setw(14) << c.play;
+            std::cout << std::setw(14) << c.env << std::setw(14) << c.terminal;
+            if (dedup) std::cout << distinct(d);
+            std::cout << std::endl;
+            total += c.nodes;
+        }
+        std::cout << std::fixed << std::setprecision(2);
+        std::cout << "total " << total << " nodes in " << sec << " s, ";
+        std::cout << std::setprecision(0) << (total / sec) << " nodes/s (" << threads << " threads)" << std::endl;
+        std::cout << std::right;
+    }
+
+protected:
+    struct node {
+        board state;
+        unsigned bag;
+        int last;
+        unsigned step;
+    };
+    struct counts {
+        uint64_t nodes, play, env, terminal;
+        counts() : nodes(0), play(0), env(0), terminal(0) {}
+        counts& operator +=(const counts& c) {
+            nodes += c.nodes, play += c.play, env += c.env, terminal += c.terminal;
+            return *this;
+        }
+    };
+
+    void search(const node& n, unsigned ply, std::vector<counts>& local) {
+        std::vector<node> next;
+        visit(n, ply, local, ply < depth ? &next : nullptr);
+        for (const node& c : next) search(c, ply + 1, local);
+    }
+
+    /**
+     * count a node at the ply, and generate its children to next (if given)
+     */
+    void visit(const node& n, unsigned ply, std::vector<counts>& local, std::vector<node>* next) {
+        counts& c = local[ply];
+        c.nodes++;
+        if (dedup) remember(n, ply);
+        bool env = n.step < 9 || n.step % 2 == 0;
+        if (env) {
+            unsigned cells = environment::edge_type::mask(n.last);
+            unsigned empty = 0;
+            for (unsigned m = cells; m; m &= m - 1) empty += (n.state(__builtin_ctz(m)) == 0);
+            if (empty == 0) {
+                c.terminal++;
+                return;
+            }
+            c.env++;
+            if (!next) return;
+            unsigned bag = n.bag ? n.bag : unsigned(environment::bag_type::full);
+            for (unsigned t = 1; bag >> (t - 1); t++) {
+                if (!(bag & (1u << (t - 1)))) continue;
+                for (unsigned m = cells; m; m &= m - 1) {
+                    unsigned pos = __builtin_ctz(m);
+                    if (n.state(pos) != 0) continue;
+                    node child = { n.state, bag & ~(1u << (t - 1)), n.last, n.step + 1 };
+                    child.state.place(pos, t);
+                    next->push_back(child);
+                }
+            }
+        } else {
+            board::moves moves = n.state.expand();
+            if (moves.over()) {
+                c.terminal++;
+                return;
+            }
+            c.play++;
+            if (!next) return;
+            for (int op = 0; op < 4; op++) {
+                if (!(moves.legal & (1u << op))) continue;
+                next->push_back({ moves.after[op], n.bag, op, n.step + 1 });
+            }
+        }
+    }
+
+    void remember(const node& n, unsigned ply) {
+        uint64_t key = n.state.pack();
+        uint64_t ext = (uint64_t(n.bag) << 8) | uint64_t(n.last + 1);
+        uint64_t h = key * 0x9e3779b97f4a7c15ull ^ (ext + 0x632be59bd9b4e019ull);
+        shard& s = seen[ply * shards + (h >> 58) % shards];
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.keys.insert(std::make_pair(key, ext));
+    }
+    size_t distinct(unsigned ply) const {
+        size_t n = 0;
+        for (size_t i = 0; i < shards; i++) n += seen[ply * shards + i].keys.size();
+        return n;
+    }
+
+    void parse(const std::string& text) {
+        const char* idx = "0123456789ABCDEF";
+        for (size_t i = 0; i < 16 && i < text.size(); i++) {
+            const char* p = std::strchr(idx, std::toupper(text[i]));
+            root.state(i) = (p && *p) ? p - idx : 0;
+        }
+    }
+
+private:
+    struct pair_hash {
+        size_t operator ()(const std::pair<uint64_t, uint64_t>& k) const {
+            return k.first * 0x9e3779b97f4a7c15ull ^ (k.second + 0x632be59bd9b4e019ull);
+        }
+    };
+    struct shard {
+        std::mutex mutex;
+        std::unordered_set<std::pair<uint64_t, uint64_t>, pair_hash> keys;
+    };
+    static constexpr size_t shards = 64;
+
+    unsigned depth;
+    unsigned bag;
+    int last;
+    unsigned step;
+    bool dedup;
+    unsigned threads;
+    node root;
+    std::vector<counts> tally;
+    std::unique_ptr<shard[]> seen;
+};
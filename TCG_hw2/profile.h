@@ -0,0 +1,192 @@
+#pragma once
+#include <vector>
+#include <array>
+#include <string>
+#include <mutex>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <unordered_map>
+#include <algorithm>
+#include "weight.h"
+#include "network.h"
+#include "allocator.h"
+
+/**
+ * sampled profile of the weight lookups of a player, for sizing the tables
+ *
+ * one in every 'rate' estimates and updates is sampled, and the feature indices it reads are
+ * counted per entry of each table of each stage; the report (see report) is made every block:
+ *   touched     the fraction of entries ever read, and the distinct entries read in the block
+ *               (the working set of the block, against which the table size can be judged)
+ *   pages       the fraction of 4 KB and 2 MB pages of the table holding a touched entry,
+ *               i.e., what the lookups cost in page faults and TLB reach
+ *   freq        the histogram of the access counts, as [n, 2n): entries% / accesses%,
+ *               e.g. 1+: 60/5 means 60% of the touched entries take 5% of the accesses
+ * the counts of a table are dense (8 bytes per entry, on lazily mapped zero pages), or hashed
+ * for the tables beyond 2^26 entries
+ *
+ * with a heatmap path, the access counts are dumped at exit as the rows
+ * 'stage table bin first last touched accesses', each table split into at most 1024 bins of its index
+ */
+class profiler {
+public:
+    profiler(const tuple_net& shape, size_t stages, size_t rate, const std::string& heatmap = "") :
+        owner(shape.owners()), rate(std::max<size_t>(rate, 1)), epoch(1), estimates(0), updates(0),
+        share(stages), path(heatmap) {
+        for (size_t s = 0; s < stages; s++)
+            for (size_t len : shape.sizes()) tables.emplace_back(len);
+        width = tables.size() / stages;
+    }
+    ~profiler() {
+        if (path.empty()) return;
+        try {
+            dump(path);
+        } catch (std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
+public:
+    /**
+     * whether the current lookup is sampled, counted by each thread on its own
+     */
+    bool sample() const {
+        static thread_local size_t tick = 0;
+        return ++tick % rate == 0;
+    }
+
+    /**
+     * count a lookup of the features 'index' (in the order of encode) in the tables w of stage s
+     */
+    void record(size_t s, const weight* w, const size_t* index, bool update) {
+        std::lock_guard<std::mutex> guard(lock);
+        (update ? updates : estimates)++;
+        share[s] += owner.size();
+        for (size_t i = 0; i < owner.size(); i++) {
+            table& t = tables[s * width + owner[i]];
+            const weight& tw = w[owner[i]];
+            t.touch(index[i], epoch);
+            t.place(static_cast<const char*>(tw.slot(index[i])) - tw.raw(), tw.raw_size());
+        }
+    }
+
+    /**
+     * the lines of the report since the last one
+     */
+    std::string report() {
+        std::lock_guard<std::mutex> guard(lock);
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(1);
+        ss << "profile = 1/" << rate << " sampled, " << estimates << " estimates, " << updates << " updates";
+        size_t total = 0;
+        for (size_t n : share) total += n;
+        for (size_t s = 0; share.size() > 1 && s < share.size(); s++)
+            ss << ", stage " << s << " = " << (total ? 100.0 * share[s] / total : 0) << "%";
+        for (size_t i = 0; i < tables.size(); i++) {
+            table& t = tables[i];
+            if (!t.accesses) continue;
+            ss << std::endl << "stage " << (i / width) << " table " << (i % width) << ": ";
+            ss << "touched " << std::setprecision(2) << (100.0 * t.touched / t.size) << "% of " << t.size;
+            ss << " (" << t.window << " in block, " << (t.touched - t.last) << " new), " << std::setprecision(1);
+            ss << "pages " << (100.0 * t.small / std::max<size_t>(t.pages[0].size(), 1)) << "% of 4k, ";
+            ss << (100.0 * t.large / std::max<size_t>(t.pages[1].size(), 1)) << "% of 2m, freq";
+            for (unsigned b = 0; b < t.entries.size(); b++) {
+                if (!t.entries[b]) continue;
+                ss << " " << (size_t(1) << b) << "+: " << std::setprecision(0) << (100.0 * t.entries[b] / t.touched)
+                   << "/" << (100.0 * t.hits[b] / t.accesses);
+            }
+            ss << std::setprecision(1);
+            t.window = 0;
+            t.last = t.touched;
+        }
+        epoch++;
+        return ss.str();
+    }
+
+    /**
+     * write the access counts of each table, binned by index, to path
+     */
+    void dump(const std::string& path) const {
+        std::ofstream out(path, std::ios::out | std::ios::trunc);
+        if (!out.is_open()) throw std::invalid_argument("cannot open " + path);
+        out << "# stage table bin first last touched accesses" << std::endl;
+        for (size_t i = 0; i < tables.size(); i++) {
+            const table& t = tables[i];
+            size_t bins = std::min<size_t>(t.size, 1024), span = (t.size + bins - 1) / bins;
+            std::vector<size_t> touched(bins), accesses(bins);
+            t.each([&](size_t k, uint32_t n) { touched[k / span]++; accesses[k / span] += n; });
+            for (size_t b = 0; b < bins; b++)
+                out << (i / width) << ' ' << (i % width) << ' ' << b << ' ' << (b * span) << ' '
+                    << std::min(t.size, (b + 1) * span) - 1 << ' ' << touched[b] << ' ' << accesses[b] << std::endl;
+        }
+    }
+
+private:
+    struct cell {
+        uint32_t count;
+        uint32_t seen; // the epoch of the last access
+    };
+
+    /**
+     * the counts of a table, with the histogram of the counts kept up to date on each access
+     */
+    struct table {
+        table(size_t len) : size(len), touched(0), last(0), window(0), accesses(0), small(0), large(0), entries(), hits() {
+            if (len <= dense_limit) dense.resize(len);
+        }
+
+        void touch(size_t i, uint32_t epoch) {
+            cell& c = dense.size() ? dense[i] : sparse[i];
+            if (c.count) {
+                unsigned b = bin(c.count);
+                entries[b]--;
+                hits[b] -= c.count;
+            } else {
+                touched++;
+            }
+            if (c.seen != epoch) window++;
+            c.seen = epoch;
+            c.count++;
+            entries[bin(c.count)]++;
+            hits[bin(c.count)] += c.count;
+            accesses++;
+        }
+        void place(size_t offset, size_t bytes) {
+            if (pages[0].empty()) {
+                pages[0].resize((bytes + 4095) >> 12);
+                pages[1].resize((bytes + (1 << 21) - 1) >> 21);
+            }
+            if (!pages[0][offset >> 12]) pages[0][offset >> 12] = true, small++;
+            if (!pages[1][offset >> 21]) pages[1][offset >> 21] = true, large++;
+        }
+        template<typename visit>
+        void each(visit f) const {
+            for (size_t i = 0; i < dense.size(); i++) if (dense[i].count) f(i, dense[i].count);
+            for (const auto& e : sparse) f(e.first, e.second.count);
+        }
+        static unsigned bin(uint32_t n) { return 31 - __builtin_clz(n); }
+
+        size_t size;
+        std::vector<cell, lazy_allocator<cell>> dense;
+        std::unordered_map<size_t, cell> sparse;
+        size_t touched, last, window, accesses;
+        std::array<std::vector<bool>, 2> pages; // touched 4 KB and 2 MB pages
+        size_t small, large;
+        std::array<size_t, 32> entries, hits;
+    };
+    static constexpr size_t dense_limit = size_t(1) << 26;
+
+    std::vector<table> tables; // stage-major, as the weights of player
+    std::vector<size_t> owner; // the table of each feature
+    size_t width;
+    size_t rate;
+    uint32_t epoch;
+    size_t estimates;
+    size_t updates;
+    std::vector<size_t> share; // the sampled lookups of each stage
+    std::mutex lock;
+    std::string path;
+};
@@ -0,0 +1,285 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "board.h"
+#include "episode.h"
+#include "archive.h"
+
+/**
+ * query engine over a saved episode log (see statistic::saves), backed by a sidecar index
+ *
+ * the index 'path.idx' holds a fixed-size record (line offset, score, steps, largest tile,
+ * tags and times) of every episode, and is rebuilt only when the log has changed;
+ * the queries scan the mapped records, and read the log only to extract positions
+ *
+ * the arguments are given as 'key=value' pairs, ranges are 'lo:hi' with either end optional
+ *   score=lo:hi     episodes with the score in range
+ *   tile=lo:hi      episodes with the largest tile in range, e.g. tile=384: (the tile values of the summary)
+ *   length=lo:hi    episodes with the number of moves in range
+ *   tag=text        episodes whose opening or closing tag contains text
+ *   group=key       aggregate the matched episodes by tile, open, close, or length/n (buckets of n moves)
+ *   at=k            print the board after the first k moves of each matched episode
+ *   limit=n         print at most n episodes (default 20)
+ * without group or at, the matched episodes are listed
+ */
+class query {
+public:
+    query(const std::string& path) : path(path), map(nullptr), size(0) {}
+    ~query() { if (map) ::munmap(map, size); }
+
+public:
+    /**
+     * open the index of the log, building it first if it is missing or stale
+     * return false if the log cannot be read, or is an archive (see archive.h)
+     */
+    bool open() {
+        struct ::stat st;
+        if (::stat(path.c_str(), &st) != 0) {
+            std::cerr << "cannot open " << path << std::endl;
+            return false;
+        }
+        if (archive::detect(path)) {
+            std::cerr << "query needs a text log, e.g. --load=" << path << " --save=stat.txt" << std::endl;
+            return false;
+        }
+        if (!attach(st) && (!build(st) || !attach(st))) return false;
+        return true;
+    }
+
+    void run(const std::string& args) {
+        range score, tile, length;
+        std::string tag, group;
+        size_t at = -1ull, limit = 20;
+        std::stringstream ss(args);
+        for (std::string pair; ss >> pair; ) {
+            std::string key = pair.substr(0, pair.find('='));
+            std::string value = pair.substr(pair.find('=') + 1);
+            if (key == "score") score = range(value);
+            else if (key == "tile") tile = range(value);
+            else if (key == "length") length = range(value);
+            else if (key == "tag") tag = value;
+            else if (key == "group") group = value;
+            else if (key == "at") at = std::stoull(value);
+            else if (key == "limit") limit = std::stoull(value);
+        }
+
+        std::vector<size_t> match;
+        for (size_t i = 0; i < count(); i++) {
+            const record& r = records()[i];
+            if (!score(r.score) || !tile(value_of(r.tile)) || !length(r.steps)) continue;
+            if (tag.size() && tags[r.open].find(tag) == std::string::npos && tags[r.close].find(tag) == std::string::npos) continue;
+            match.push_back(i);
+        }
+
+        std::cout << match.size() << " of " << count() << " episodes matched" << std::endl;
+        if (group.size()) {
+            aggregate(match, group);
+        } else if (at != -1ull) {
+            extract(match, at, limit);
+        } else {
+            std::cout << "index\tscore\tlength\ttile\topen\tclose" << std::endl;
+            for (size_t k = 0; k < match.size() && k < limit; k++) {
+                const record& r = records()[match[k]];
+                std::cout << match[k] << '\t' << r.score << '\t' << r.steps << '\t' << value_of(r.tile) << '\t';
+                std::cout << tags[r.open] << '@' << r.begin << '\t' << tags[r.close] << '@' << r.end << std::endl;
+            }
+        }
+    }
+
+protected:
+    /**
+     * the index file: a header, the records, and the tag strings (each a uint32 length and the bytes)
+     */
+    struct header {
+        char magic[8];
+        uint64_t size;  // of the log when indexed
+        int64_t mtime;  // of the log when indexed, in nanoseconds
+        uint64_t count; // of the records
+        uint64_t tags;  // of the tag strings
+    };
+    struct record {
+        uint64_t offset; // of the line in the log
+        uint32_t length; // of the line
+        int32_t score;
+        uint32_t steps;
+        uint32_t tile;   // the largest tile index
+        uint32_t open;   // the tag id of ep_open
+        uint32_t close;  // the tag id of ep_close
+        int64_t begin;   // ep_open.when
+        int64_t end;     // ep_close.when
+    };
+    static const char* signature() { return "TCGIDX1"; }
+
+    struct range {
+        int64_t lo, hi;
+        range(const std::string& text = ":") : lo(INT64_MIN), hi(INT64_MAX) {
+            size_t colon = text.find(':');
+            std::string a = text.substr(0, colon), b = colon != std::string::npos ? text.substr(colon + 1) : a;
+            if (a.size()) lo = std::stoll(a);
+            if (b.size()) hi = std::stoll(b);
+        }
+        bool operator ()(int64_t v) const { return v >= lo && v <= hi; }
+    };
+
+    static int64_t mtime(const struct ::stat& st) { return int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec; }
+    static unsigned value_of(unsigned t) { return (1u << t) & -2u; }
+
+    size_t count() const { return static_cast<const header*>(map)->count; }
+    const record* records() const { return reinterpret_cast<const record*>(static_cast<const char*>(map) + sizeof(header)); }
+
+    /**
+     * map the index if it matches the log
+     */
+    bool attach(const struct ::stat& st) {
+        int fd = ::open((path + ".idx").c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct ::stat is;
+        ::fstat(fd, &is);
+        size = is.st_size;
+        map = size >= sizeof(header) ? ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+        ::close(fd);
+        if (map == MAP_FAILED) return (map = nullptr), false;
+        const header& h = *static_cast<const header*>(map);
+        bool valid = std::strncmp(h.magic, signature(), 8) == 0 && h.size == uint64_t(st.st_size) && h.mtime == mtime(st)
+                  && sizeof(header) + h.count * sizeof(record) <= size;
+        const char* p = static_cast<const char*>(map) + sizeof(header) + (valid ? h.count * sizeof(record) : 0);
+        const char* last = static_cast<const char*>(map) + size;
+        tags.clear();
+        for (size_t i = 0; valid && i < h.tags; i++) {
+            uint32_t len;
+            if (p + sizeof(len) > last) { valid = false; break; }
+            std::memcpy(&len, p, sizeof(len));
+            if (p + sizeof(len) + len > last) { valid = false; break; }
+            tags.emplace_back(p + sizeof(len), len);
+            p += sizeof(len) + len;
+        }
+        if (!valid) {
+            ::munmap(map, size);
+            map = nullptr;
+        }
+        return valid;
+    }
+
+    /**
+     * parse the whole log once and write the index
+     */
+    bool build(const struct ::stat& st) {
+        std::ifstream in(path, std::ios::in | std::ios::binary);
+        if (!in.is_open()) return false;
+        std::vector<record> rec;
+        std::vector<std::string> names;
+        std::unordered_map<std::string, uint32_t> id;
+        auto intern = [&](const std::string& tag) {
+            auto it = id.find(tag);
+            if (it != id.end()) return it->second;
+            names.push_back(tag);
+            return id[tag] = names.size() - 1;
+        };
+        episode ep;
+        uint64_t offset = 0;
+        for (std::string line; std::getline(in, line) && line.size(); offset += line.size() + 1) {
+            if (in.eof()) break; // the truncated last line of an interrupted save
+            if (!ep.parse(line.data(), line.data() + line.size())) continue;
+            record r;
+            r.offset = offset;
+            r.length = line.size();
+            r.score = ep.score();
+            r.steps = ep.step();
+            r.tile = *std::max_element(&(ep.state()(0)), &(ep.state()(16)));
+            r.open = intern(ep.ep_open.tag);
+            r.close = intern(ep.ep_close.tag);
+            r.begin = ep.ep_open.when;
+            r.end = ep.ep_close.when;
+            rec.push_back(r);
+        }
+
+        header h;
+        std::memset(&h, 0, sizeof(h));
+        std::strncpy(h.magic, signature(), sizeof(h.magic));
+        h.size = st.st_size;
+        h.mtime = mtime(st);
+        h.count = rec.size();
+        h.tags = names.size();
+        std::ofstream out(path + ".idx.tmp", std::ios::out | std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.write(reinterpret_cast<const char*>(rec.data()), sizeof(record) * rec.size());
+        for (const std::string& name : names) {
+            uint32_t len = name.size();
+            out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+            out.write(name.data(), len);
+        }
+        out.close();
+        if (!out || std::rename((path + ".idx.tmp").c_str(), (path + ".idx").c_str()) != 0) return false;
+        std::cerr << "indexed " << rec.size() << " episodes of " << path << std::endl;
+        return true;
+    }
+
+    /**
+     * print the count, average and maximum score, and average length of each group
+     */
+    void aggregate(const std::vector<size_t>& match, const std::string& group) {
+        struct stats { size_t n; int64_t sum; int32_t max; uint64_t steps; };
+        std::map<std::string, stats> res;
+        size_t bucket = group.find("length/") == 0 ? std::max(1ull, std::stoull(group.substr(7))) : 0;
+        std::vector<std::pair<uint64_t, std::string>> order;
+        for (size_t i : match) {
+            const record& r = records()[i];
+            std::string key;
+            if (group == "tile") key = std::to_string(value_of(r.tile));
+            else if (group == "open") key = tags[r.open];
+            else if (group == "close") key = tags[r.close];
+            else if (bucket) key = std::to_string(r.steps / bucket * bucket);
+            else key = "all";
+            auto it = res.find(key);
+            if (it == res.end()) {
+                it = res.insert({ key, { 0, 0, r.score, 0 } }).first;
+                order.push_back({ (group == "tile") ? value_of(r.tile) : bucket ? r.steps / bucket * bucket : 0, key });
+            }
+            stats& s = it->second;
+            s.n++, s.sum += r.score, s.max = std::max(s.max, r.score), s.steps += r.steps;
+        }
+        std::sort(order.begin(), order.end());
+        std::cout << group << "\tcount\tavg\tmax\tlength" << std::endl;
+        for (const auto& o : order) {
+            const stats& s = res[o.second];
+            std::cout << o.second << '\t' << s.n << '\t' << (s.sum / int64_t(s.n)) << '\t' << s.max << '\t' << (s.steps / s.n) << std::endl;
+        }
+    }
+
+    /**
+     * print the board after the first k moves of each matched episode, as 16 tile indices in 0-9A-F
+     */
+    void extract(const std::vector<size_t>& match, size_t k, size_t limit) {
+        std::ifstream in(path, std::ios::in | std::ios::binary);
+        std::cout << "index\tboard" << std::endl;
+        std::string line;
+        episode ep;
+        for (size_t n = 0; n < match.size() && n < limit; n++) {
+            const record& r = records()[match[n]];
+            line.resize(r.length);
+            in.seekg(r.offset);
+            if (!in.read(&line[0], r.length) || !ep.parse(line.data(), line.data() + line.size())) continue;
+            board b = ep.state_at(k);
+            std::cout << match[n] << '\t';
+            for (int i = 0; i < 16; i++) std::cout << "0123456789ABCDEF"[std::min<board::cell>(b(i), 15)];
+            std::cout << std::endl;
+        }
+    }
+
+private:
+    std::string path;
+    void* map;
+    size_t size;
+    std::vector<std::string> tags;
+};
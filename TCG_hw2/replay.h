@@ -0,0 +1,92 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+#include "statistic.h"
+
+/**
+ * environment on common random numbers, for comparing players on the same sequences (see compare.h)
+ *
+ * the k-th placement of episode n draws only from the k-th slice of the stream keyed by (seed, n),
+ * so the tiles and the random order of the cells are the same whatever the player did before,
+ * unlike rndenv, whose later draws shift as soon as two games differ
+ *
+ * with replay=path, the tiles and positions of the episodes of a saved log are replayed in order;
+ * a recorded position which is not legal on the current board, and the placements beyond the
+ * end of the record, fall back to the seeded draw
+ */
+class replayenv : public rndenv {
+public:
+    replayenv(const std::string& args = "") : rndenv("name=replay " + args), step(0), current(0) {
+        if (meta.find("replay") != meta.end()) // pass replay=... to replay the environment of a log
+            load(meta["replay"]);
+    }
+
+    virtual void open_episode(const std::string& flag = "") {
+        rndenv::open_episode(flag);
+        current = index - 1;
+        step = 0;
+    }
+
+    virtual action take_action(const board& after) {
+        engine.seed(seed, current);
+        engine.discard(step * slice);
+        const std::vector<uint8_t>* rec = current < records.size() ? &records[current] : nullptr;
+        int recorded = rec && step < rec->size() ? (*rec)[step] : -1;
+        step++;
+
+        board::cell tile = environment::bag_type::next(bag, engine);
+        if (recorded != -1 && board::cell(recorded >> 4) != tile) {
+            auto it = std::find(bag.begin(), bag.end(), board::cell(recorded >> 4));
+            if (it != bag.end()) *it = tile; // keep the drawn tile in the bag for the recorded one
+            tile = recorded >> 4;
+        }
+
+        std::vector<int> legalspace = environment::edge_type::space(operation);
+        if (recorded != -1) {
+            int pos = recorded & 0x0f;
+            if (std::find(legalspace.begin(), legalspace.end(), pos) != legalspace.end() && after(pos) == 0)
+                return action::place(pos, tile);
+        }
+
+        std::shuffle(legalspace.begin(), legalspace.end(), engine);
+        for (int pos : legalspace) {
+            if (after(pos) != 0) continue;
+            return action::place(pos, tile);
+        }
+        return action();
+    }
+
+    size_t replays() const { return records.size(); }
+
+protected:
+    /**
+     * keep the placements of every episode of the log, each as a byte of position and tile
+     */
+    void load(const std::string& path) {
+        statistic log(0);
+        if (!log.load(path)) {
+            std::ifstream in(path, std::ios::in);
+            if (!in.is_open()) throw std::invalid_argument("cannot open " + path);
+            in >> log;
+        }
+        for (const episode& ep : log) {
+            records.emplace_back();
+            for (const action& a : ep.actions()) {
+                if (a.type() != action::place::type) continue;
+                action::place p(a);
+                records.back().push_back(p.position() | (std::min(p.tile(), 15u) << 4));
+            }
+        }
+    }
+
+private:
+    static constexpr uint64_t slice = 64; // draws reserved for a placement, a bag shuffle and a cell shuffle take at most 17
+    size_t step;
+    size_t current;
+    std::vector<std::vector<uint8_t>> records;
+};
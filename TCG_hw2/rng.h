@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <limits>
+
+/**
+ * counter-based random number generator (SplitMix64 output function)
+ *
+ * the n-th number of a stream is a pure function of (seed, stream, n),
+ * so a stream keyed by (seed, episode index) can be regenerated independently,
+ * on any thread and in any order, and always gives the same sequence
+ *
+ * satisfies UniformRandomBitGenerator, so it works with std::shuffle and the distributions
+ */
+class counter_rng {
+public:
+    typedef uint64_t result_type;
+
+    counter_rng(uint64_t seed = 0, uint64_t stream = 0) { this->seed(seed, stream); }
+
+    void seed(uint64_t seed, uint64_t stream = 0) {
+        key = mix(mix(seed) ^ (stream * 0xd1b54a32d192ed03ull));
+        count = 0;
+    }
+    void discard(uint64_t n) { count += n; }
+
+    result_type operator ()() { return mix(key + (++count) * golden); }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+protected:
+    static constexpr uint64_t golden = 0x9e3779b97f4a7c15ull;
+
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+private:
+    uint64_t key;
+    uint64_t count;
+};
@@ -0,0 +1,198 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "board.h"
+#include "action.h"
+#include "agent.h"
+
+/**
+ * move server, keeps the player and its network resident between requests
+ *
+ * text requests are lines of boards, each board is 16 cells (1-d form order)
+ * of tile indices in 0-9A-F, as in the placing actions
+ *   move B1 B2 ...    reply the greedy move of each board, e.g. '#U #L ??' ('??' if no legal move)
+ *   best B1 B2 ...    reply the greedy move and its value (reward + after-state value), e.g. '#U 123.5 ?? 0'
+ *   value B1 B2 ...   reply the value of each board as an after-state, e.g. '123.5 97.25'
+ *   quit              close the connection
+ *
+ * binary requests start with a kind byte (1: best, 2: value), followed by a uint32 count n
+ * and n uint64 packed boards (see board::pack); the reply of best is n opcode bytes
+ * (255 if no legal move) followed by n floats, and the reply of value is n floats;
+ * a request of more than batch_limit boards closes the connection
+ *
+ * the boards of a request are expanded first, and their after-states are then evaluated in one batch
+ */
+class server {
+public:
+    server(const player& play) : play(play) {}
+
+public:
+    /**
+     * serve requests from a unix socket at path, one connection at a time
+     */
+    bool listen(const std::string& path) {
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0) return false;
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        ::unlink(path.c_str());
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, 16) != 0) {
+            ::close(fd);
+            return false;
+        }
+        for (int conn; (conn = ::accept(fd, nullptr, nullptr)) >= 0; ) {
+            serve(conn, conn);
+            ::close(conn);
+        }
+        ::close(fd);
+        return true;
+    }
+
+    /**
+     * serve requests from in and reply to out until the end of input or 'quit'
+     */
+    void serve(int in, int out) {
+        this->in = in;
+        this->out = out;
+        head = tail = 0;
+        for (int c; (c = peek()) >= 0; ) {
+            bool ok = (c == 1 || c == 2) ? binary() : text();
+            if (!ok) break;
+        }
+    }
+
+protected:
+    static constexpr uint32_t batch_limit = 1 << 20; // boards of a binary request, 8 MB of packed boards
+
+    bool text() {
+        std::string line;
+        for (int c; (c = get()) >= 0 && c != '\n'; ) line += char(c);
+        if (line.size() && line.back() == '\r') line.pop_back();
+        std::stringstream ss(line);
+        std::string cmd;
+        if (!(ss >> cmd)) return true;
+        if (cmd == "quit") return false;
+
+        std::vector<board> boards;
+        for (std::string b; ss >> b; ) {
+            board s;
+            if (!parse(b, s)) return reply("error: invalid board " + b + "\n");
+            boards.push_back(s);
+        }
+        std::stringstream res;
+        if (cmd == "move" || cmd == "best") {
+            std::vector<int> op;
+            std::vector<float> value;
+            best(boards, op, value);
+            for (size_t i = 0; i < boards.size(); i++) {
+                if (i) res << ' ';
+                res << (op[i] >= 0 ? action::slide(op[i]) : action());
+                if (cmd == "best") res << ' ' << value[i];
+            }
+        } else if (cmd == "value") {
+            std::vector<uint64_t> packed;
+            for (const board& b : boards) packed.push_back(b.pack());
+            std::vector<float> value(packed.size());
+            play.get_board_value(packed.data(), packed.size(), value.data());
+            for (size_t i = 0; i < value.size(); i++) res << (i ? " " : "") << value[i];
+        } else {
+            return reply("error: unknown request " + cmd + "\n");
+        }
+        res << '\n';
+        return reply(res.str());
+    }
+
+    bool binary() {
+        char kind = get();
+        uint32_t n;
+        if (!read(&n, sizeof(n)) || n > batch_limit) return false;
+        std::vector<uint64_t> packed(n);
+        if (!read(packed.data(), sizeof(uint64_t) * n)) return false;
+        std::string res;
+        std::vector<float> value(n);
+        if (kind == 1) {
+            std::vector<board> boards;
+            for (uint64_t p : packed) boards.push_back(board::unpack(p));
+            std::vector<int> op;
+            best(boards, op, value);
+            for (int o : op) res += char(o >= 0 ? o : 255);
+        } else {
+            play.get_board_value(packed.data(), n, value.data());
+        }
+        res.append(reinterpret_cast<const char*>(value.data()), sizeof(float) * n);
+        return reply(res);
+    }
+
+    void best(const std::vector<board>& boards, std::vector<int>& op, std::vector<float>& value) {
+        std::vector<board::moves> moves;
+        moves.reserve(boards.size());
+        for (const board& b : boards) moves.push_back(b.expand());
+        op.resize(boards.size());
+        value.resize(boards.size());
+        play.select(moves.data(), moves.size(), op.data(), value.data());
+    }
+
+    static bool parse(const std::string& text, board& b) {
+        if (text.size() != 16) return false;
+        const char* idx = "0123456789ABCDEF";
+        for (int i = 0; i < 16; i++) {
+            const char* p = std::strchr(idx, std::toupper(text[i]));
+            if (!p || !*p) return false;
+            b(i) = p - idx;
+        }
+        return true;
+    }
+
+    bool reply(const std::string& data) {
+        size_t done = 0;
+        while (done < data.size()) {
+            // a client gone away must not raise SIGPIPE, so sockets are written by send with MSG_NOSIGNAL
+            ssize_t n = ::send(out, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+            if (n < 0 && errno == ENOTSOCK) n = ::write(out, data.data() + done, data.size() - done);
+            if (n <= 0) return false;
+            done += n;
+        }
+        return true;
+    }
+
+    int peek() {
+        if (head == tail) {
+            ssize_t n;
+            do n = ::read(in, buf, sizeof(buf)); while (n < 0 && errno == EINTR);
+            if (n <= 0) return -1;
+            head = 0;
+            tail = n;
+        }
+        return (unsigned char) buf[head];
+    }
+    int get() {
+        int c = peek();
+        if (c >= 0) head++;
+        return c;
+    }
+    bool read(void* data, size_t len) {
+        char* p = static_cast<char*>(data);
+        for (size_t i = 0; i < len; i++) {
+            int c = get();
+            if (c < 0) return false;
+            p[i] = char(c);
+        }
+        return true;
+    }
+
+private:
+    const player& play;
+    int in, out;
+    char buf[65536];
+    size_t head, tail;
+};
@@ -0,0 +1,245 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <array>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include "board.h"
+#include "weight.h"
+#include "network.h"
+
+/**
+ * n-tuple network loaded from a specification file at startup
+ *
+ * the file is a list of directives, '#' starts a comment
+ *   pattern 0 4 8 1 5 9   a tuple of cells (1-d form index), at most 8 cells
+ *   symmetry 8            symmetries of the following patterns:
+ *                         8 (rotations and reflections), 4 (rotations), or 1 (none)
+ *   clip 15               the largest tile index of a cell, larger tiles are clipped;
+ *                         a table of an n-tuple has (clip + 1)^n entries
+ *   hash 1048576          the capacity of the tables of the following patterns, which are then
+ *                         hashed tables holding only the entries visited (see weight); 0 for dense
+ *
+ * the feature encoders are specialized by the pattern length at compile time,
+ * with shifts for clip 15 (4 bits per cell) and multiplications otherwise
+ *
+ * e.g., the 7- and 8-tuples of (clip + 1)^8 entries are too large to be dense,
+ * but only a small part of them is ever reached in play
+ */
+class spec_net : public tuple_net {
+public:
+    spec_net(const std::string& path) : clip(15), count(0), hashing(false) {
+        std::ifstream in(path);
+        if (!in.is_open()) throw std::invalid_argument("cannot open network spec " + path);
+        unsigned symmetry = 8;
+        size_t capacity = 0;
+        for (std::string line; std::getline(in, line); ) {
+            std::stringstream ss(line.substr(0, line.find('#')));
+            std::string key;
+            if (!(ss >> key)) continue;
+            if (key == "pattern") {
+                std::vector<unsigned> cells;
+                for (unsigned c; ss >> c; ) {
+                    if (c >= 16) throw std::invalid_argument("invalid cell in spec: " + line);
+                    cells.push_back(c);
+                }
+                if (cells.empty() || cells.size() > 8) throw std::invalid_argument("invalid pattern in spec: " + line);
+                patterns.push_back({ cells, symmetry, capacity });
+                hashing |= capacity > 0;
+            } else if (key == "symmetry") {
+                ss >> symmetry;
+                if (symmetry != 1 && symmetry != 4 && symmetry != 8) throw std::invalid_argument("invalid symmetry in spec: " + line);
+            } else if (key == "hash") {
+                if (!(ss >> capacity)) throw std::invalid_argument("invalid hash in spec: " + line);
+            } else if (key == "clip") {
+                ss >> clip;
+                if (clip < 1 || clip > 255) throw std::invalid_argument("invalid clip in spec: " + line);
+            } else {
+                throw std::invalid_argument("unknown directive in spec: " + line);
+            }
+        }
+        if (patterns.empty()) throw std::invalid_argument("no pattern in network spec " + path);
+        for (const auto& p : patterns) { // a table of (clip + 1)^n entries must be indexable by size_t
+            size_t len = 1;
+            for (size_t j = 0; j < p.cells.size(); j++) {
+                if (len > SIZE_MAX / (clip + 1)) throw std::invalid_argument("too large table for clip " + std::to_string(clip) + " in spec " + path);
+                len *= (clip + 1);
+            }
+        }
+
+        for (size_t i = 0; i < patterns.size(); i++) {
+            for (unsigned k = 8 - patterns[i].symmetry; k < 8; k++) {
+                feature f;
+                f.table = i;
+                for (size_t j = 0; j < patterns[i].cells.size(); j++) f.cells[j] = isomorphic_cell(patterns[i].cells[j], k);
+                group[patterns[i].cells.size()].push_back(f);
+                count++;
+            }
+        }
+        for (unsigned n = 1; n <= 8; n++) {
+            first[n] = table.size();
+            for (const feature& f : group[n]) table.push_back(f.table);
+        }
+        first[9] = table.size();
+    }
+
+public:
+    std::vector<size_t> sizes() const {
+        std::vector<size_t> v;
+        for (const auto& p : patterns) {
+            size_t len = 1;
+            for (size_t j = 0; j < p.cells.size(); j++) len *= (clip + 1);
+            v.push_back(len);
+        }
+        return v;
+    }
+    std::vector<size_t> capacities() const {
+        std::vector<size_t> v;
+        for (const auto& p : patterns) v.push_back(p.capacity);
+        return v;
+    }
+    using tuple_net::estimate;
+    size_t lookups() const { return count; }
+    layout_t layout() const {
+        layout_t l;
+        for (unsigned n = 1; n <= 8; n++)
+            for (const feature& f : group[n]) l.cells.emplace_back(f.cells.begin(), f.cells.begin() + n);
+        l.clip = clip;
+        return l;
+    }
+    void encode(const board& s, size_t* index) const {
+        for (unsigned n = 1; n <= 8; n++) {
+            if (group[n].empty()) continue;
+            switch (n) {
+            case 1: index = encode<1>(s, index); break;
+            case 2: index = encode<2>(s, index); break;
+            case 3: index = encode<3>(s, index); break;
+            case 4: index = encode<4>(s, index); break;
+            case 5: index = encode<5>(s, index); break;
+            case 6: index = encode<6>(s, index); break;
+            case 7: index = encode<7>(s, index); break;
+            case 8: index = encode<8>(s, index); break;
+            }
+        }
+    }
+    std::vector<size_t> owners() const { return table; }
+    float estimate(const weight* net, const size_t* index) const {
+        float v = 0;
+        for (unsigned n = 1; n <= 8; n++) {
+            if (group[n].empty()) continue;
+            float u = 0;
+            if (hashing) for (size_t i = first[n]; i < first[n + 1]; i++) u += net[table[i]].find(index[i]);
+            else for (size_t i = first[n]; i < first[n + 1]; i++) u += net[table[i]][index[i]];
+            v += u;
+        }
+        return v;
+    }
+    void update(weight* net, const size_t* index, double u) const {
+        if (hashing) for (size_t i = 0; i < table.size(); i++) net[table[i]].add(index[i], u);
+        else for (size_t i = 0; i < table.size(); i++) net[table[i]][index[i]] += u;
+    }
+
+    float estimate(const weight* net, const board& s) const {
+        float v = 0;
+        for (unsigned n = 1; n <= 8; n++) {
+            if (group[n].empty()) continue;
+            switch (n) {
+            case 1: v += estimate<1>(net, s); break;
+            case 2: v += estimate<2>(net, s); break;
+            case 3: v += estimate<3>(net, s); break;
+            case 4: v += estimate<4>(net, s); break;
+            case 5: v += estimate<5>(net, s); break;
+            case 6: v += estimate<6>(net, s); break;
+            case 7: v += estimate<7>(net, s); break;
+            case 8: v += estimate<8>(net, s); break;
+            }
+        }
+        return v;
+    }
+    void prefetch(const weight* net, const board& s) const {
+        for (unsigned n = 1; n <= 8; n++) {
+            if (group[n].empty()) continue;
+            switch (n) {
+            case 1: prefetch<1>(net, s); break;
+            case 2: prefetch<2>(net, s); break;
+            case 3: prefetch<3>(net, s); break;
+            case 4: prefetch<4>(net, s); break;
+            case 5: prefetch<5>(net, s); break;
+            case 6: prefetch<6>(net, s); break;
+            case 7: prefetch<7>(net, s); break;
+            case 8: prefetch<8>(net, s); break;
+            }
+        }
+    }
+    void update(weight* net, const board& s, double u) const {
+        for (unsigned n = 1; n <= 8; n++) {
+            if (group[n].empty()) continue;
+            switch (n) {
+            case 1: update<1>(net, s, u); break;
+            case 2: update<2>(net, s, u); break;
+            case 3: update<3>(net, s, u); break;
+            case 4: update<4>(net, s, u); break;
+            case 5: update<5>(net, s, u); break;
+            case 6: update<6>(net, s, u); break;
+            case 7: update<7>(net, s, u); break;
+            case 8: update<8>(net, s, u); break;
+            }
+        }
+    }
+
+protected:
+    struct feature {
+        size_t table;
+        std::array<unsigned, 8> cells;
+    };
+
+    template<unsigned n>
+    size_t encode(const feature& f, const board& s) const {
+        size_t index = 0;
+        if (clip == 15) {
+            for (unsigned j = 0; j < n; j++) index |= size_t(std::min<board::cell>(s(f.cells[j]), 15)) << (4 * j);
+        } else {
+            for (unsigned j = n; j-- > 0; ) index = index * (clip + 1) + std::min<board::cell>(s(f.cells[j]), clip);
+        }
+        return index;
+    }
+
+    template<unsigned n>
+    float estimate(const weight* net, const board& s) const {
+        float v = 0;
+        if (hashing) for (const feature& f : group[n]) v += net[f.table].find(encode<n>(f, s));
+        else for (const feature& f : group[n]) v += net[f.table][encode<n>(f, s)];
+        return v;
+    }
+    template<unsigned n>
+    void update(weight* net, const board& s, double u) const {
+        if (hashing) for (const feature& f : group[n]) net[f.table].add(encode<n>(f, s), u);
+        else for (const feature& f : group[n]) net[f.table][encode<n>(f, s)] += u;
+    }
+    template<unsigned n>
+    size_t* encode(const board& s, size_t* index) const {
+        for (const feature& f : group[n]) *(index++) = encode<n>(f, s);
+        return index;
+    }
+    template<unsigned n>
+    void prefetch(const weight* net, const board& s) const {
+        for (const feature& f : group[n]) __builtin_prefetch(net[f.table].slot(encode<n>(f, s)));
+    }
+
+private:
+    struct tuple {
+        std::vector<unsigned> cells;
+        unsigned symmetry;
+        size_t capacity;
+    };
+    std::vector<tuple> patterns;
+    std::array<std::vector<feature>, 9> group;
+    std::vector<size_t> table; // the table of each feature, in the order of estimate
+    std::array<size_t, 10> first; // the first feature of each length in table
+    unsigned clip;
+    size_t count;
+    bool hashing; // whether any table is hashed, then all tables are accessed by find and add
+};
@@ -0,0 +1,192 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include "board.h"
+#include "agent.h"
+#include "rng.h"
+
+/**
+ * evaluation with early stopping by a sequential probability ratio test
+ *
+ * the games are played greedily (no training) by threads, and the results are fed to the test
+ * in the order of the game numbers, so that short games finishing first do not bias the decision;
+ * the run stops as soon as the log-likelihood ratio crosses a bound, or after --total games
+ *
+ * the hypothesis is one of
+ *   score=m0:m1       the average score is at most m0 (H0), or at least m1 (H1)
+ *   reach=t:p0:p1     the rate of reaching tile t (e.g. 384) is at most p0 (H0), or at least p1 (H1)
+ *   diff=d0:d1        the average score of the player exceeds that of --compare by at most d0 (H0),
+ *                     or by at least d1 (H1), both playing game n on common random numbers
+ * where the scores are tested as normal with the sample variance, and the reach as bernoulli
+ *
+ * the other arguments are given as 'key=value' pairs
+ *   alpha=a beta=b    the error rates of accepting H1 and H0 wrongly (default 0.05)
+ *   thread=n          the number of threads (default 1)
+ *   seed=n            the seed of the environment (default 0)
+ */
+class sprt {
+public:
+    sprt(const player& play, const player* other, const std::string& args, size_t block)
+        : play(play), other(other), block(block ? block : -1ull), kind(score), tile(0), h0(0), h1(0),
+          alpha(0.05), beta(0.05), threads(1), seed(0), fed(0), sum(0), sq(0), sa(0), sb(0), decision(0) {
+        std::stringstream ss(args);
+        for (std::string pair; ss >> pair; ) {
+            std::string key = pair.substr(0, pair.find('='));
+            std::string value = pair.substr(pair.find('=') + 1);
+            std::replace(value.begin(), value.end(), ':', ' ');
+            std::stringstream in(value);
+            if (key == "score") kind = score, in >> h0 >> h1;
+            else if (key == "reach") kind = reach, in >> tile >> h0 >> h1;
+            else if (key == "diff") kind = diff, in >> h0 >> h1;
+            else if (key == "alpha") in >> alpha;
+            else if (key == "beta") in >> beta;
+            else if (key == "thread") threads = std::max(1ul, std::stoul(value));
+            else if (key == "seed") seed = std::stoull(value);
+        }
+        if (kind == diff && !other) throw std::invalid_argument("diff= needs the other player of --compare");
+        if (h1 == h0) throw std::invalid_argument("the hypotheses must differ");
+    }
+
+public:
+    /**
+     * play until the test decides or total games are played, and print every block, e.g.
+     * 1000    avg = 857, llr = 1.52 [-2.94, 2.94], 2107 games/s
+     * ...
+     * H1 accepted after 1840 games: the average score is at least 900
+     */
+    void run(size_t total) {
+        start = std::chrono::steady_clock::now();
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < threads; i++) {
+            workers.emplace_back([&]() {
+                for (size_t n; !decision && (n = next++) < total; ) {
+                    result a = evaluate(play, n), b = other ? evaluate(*other, n) : result{ 0, 0 };
+                    std::lock_guard<std::mutex> lock(mutex);
+                    pending[n] = { a, b };
+                    feed(total);
+                }
+            });
+        }
+        for (std::thread& w : workers) w.join();
+        if (fed % block) show();
+
+        const char* what[] = { "the average score", "the reach rate", "the average difference" };
+        std::cout << (decision > 0 ? "H1 accepted" : decision < 0 ? "H0 accepted" : "undecided") << " after " << fed << " games";
+        if (decision) std::cout << ": " << what[kind] << (decision < 0 ? " is at most " : " is at least ") << (decision < 0 ? h0 : h1);
+        if (decision && kind == reach) std::cout << " for " << tile;
+        std::cout << std::endl;
+    }
+
+protected:
+    enum hypothesis { score, reach, diff };
+    struct result { double score; unsigned tile; };
+
+    /**
+     * consume the results in the order of game numbers, update the test, and print every block
+     */
+    void feed(size_t total) {
+        for (auto it = pending.begin(); !decision && it != pending.end() && it->first == fed; it = pending.erase(it)) {
+            double a = it->second.first.score, b = it->second.second.score;
+            double x = kind == diff ? a - b : kind == reach ? it->second.first.tile >= tile : a;
+            sum += x, sq += x * x, sa += a, sb += b;
+            fed++;
+            double r = llr();
+            if (fed >= least) decision = r >= std::log((1 - beta) / alpha) ? 1 : r <= std::log(beta / (1 - alpha)) ? -1 : 0;
+            if (fed % block == 0 || decision || fed == total) show();
+        }
+    }
+
+    /**
+     * the log-likelihood ratio of H1 to H0 over the results fed so far
+     */
+    double llr() const {
+        if (kind == reach) {
+            double k = sum, p0 = std::min(std::max(h0, 1e-6), 1 - 1e-6), p1 = std::min(std::max(h1, 1e-6), 1 - 1e-6);
+            return k * std::log(p1 / p0) + (fed - k) * std::log((1 - p1) / (1 - p0));
+        }
+        if (fed < 2) return 0;
+        double var = std::max((sq - sum * sum / fed) / (fed - 1), 1e-9);
+        return (h1 - h0) / var * (sum - fed * (h0 + h1) / 2);
+    }
+
+    void show() const {
+        if (fed == 0) return;
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::ios ff(nullptr);
+        ff.copyfmt(std::cout);
+        std::cout << std::fixed << std::setprecision(0);
+        std::cout << fed << "\t";
+        std::cout << "avg = " << (sa / fed);
+        if (other) std::cout << " (" << (sb / fed) << ")";
+        if (kind == reach) std::cout << ", reach = " << std::setprecision(3) << (sum / fed);
+        std::cout << std::setprecision(2);
+        std::cout << ", llr = " << llr() << " [" << std::log(beta / (1 - alpha)) << ", " << std::log((1 - beta) / alpha) << "]";
+        std::cout << std::setprecision(0);
+        std::cout << ", " << (fed * (other ? 2 : 1) / sec) << " games/s" << std::endl;
+        std::cout.copyfmt(ff);
+    }
+
+    /**
+     * play game n greedily, and return its score and largest tile
+     * the k-th placement draws from the k-th slice of the stream keyed by (seed, n), as replayenv does,
+     * so both players of diff= see the same tiles
+     */
+    result evaluate(const player& who, size_t n) const {
+        board state;
+        counter_rng rng;
+        unsigned bag = 0;
+        int last = -1, total = 0;
+        for (size_t step = 0; ; step++) {
+            if (step >= 9) {
+                board::moves moves = state.expand();
+                int op = who.select(moves);
+                if (op == -1) break;
+                state = moves.after[op];
+                total += moves.score[op];
+                last = op;
+            }
+            rng.seed(seed, n);
+            rng.discard(step * 64);
+            unsigned empty[16], k = 0;
+            for (unsigned m = environment::edge_type::mask(last); m; m &= m - 1)
+                if (state(__builtin_ctz(m)) == 0) empty[k++] = __builtin_ctz(m);
+            if (k == 0) break;
+            unsigned t = environment::bag_type::draw(bag, rng);
+            state.place(empty[rng() % k], t);
+        }
+        unsigned max = 0;
+        for (unsigned i = 0; i < 16; i++) max = std::max<unsigned>(max, state(i));
+        return { double(total), (1u << max) & -2u };
+    }
+
+private:
+    static constexpr size_t least = 30; // the fewest games to decide, for a stable sample variance
+    const player& play;
+    const player* other;
+    size_t block;
+    hypothesis kind;
+    unsigned tile;
+    double h0, h1;
+    double alpha, beta;
+    size_t threads;
+    uint64_t seed;
+
+    std::mutex mutex;
+    std::map<size_t, std::pair<result, result>> pending;
+    size_t fed;
+    double sum, sq, sa, sb;
+    std::atomic<int> decision;
+    std::chrono::steady_clock::time_point start;
+};
@@ -3,17 +3,27 @@
 #include <algorithm>
 #include <iostream>
 #include <sstream>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "board.h"
 #include "action.h"
 #include "agent.h"
 #include "episode.h"
+#include "writer.h"
+#include "archive.h"
 
 class statistic {
 public:
     /**
      * the total episodes to run
      * the block size of statistic
-     * the limit of saving records
+     * the limit of records held in memory, i.e., what --summary covers
+     * (a save file still gets every episode, see saves)
      *
      * note that total >= limit >= block
      */
@@ -21,7 +31,13 @@ public:
         : total(total),
           block(block ? block : total),
           limit(limit ? limit : total),
-          count(0) {}
+          count(0),
+          prom(false),
+          packed(false),
+          lines(0) {}
+    ~statistic() {
+        if (log && packed) flush(); // the last block, before the writer closes
+    }
 
 public:
     /**
@@ -45,8 +61,10 @@ public:
      *                                  the average speed of environment is 896715
      *  '93.7%': 93.7% (937 games) reached 8192-tiles (a.k.a. win rate of 8192-tile)
      *  '22.4%': 22.4% (224 games) terminated with 8192-tiles (the largest)
+     *
+     * lines given by annotate() since the last block are listed below the first line
      */
-    void show(bool tstat = true) const {
+    void show(bool tstat = true) {
         size_t blk = std::min(data.size(), block);
         size_t stat[64] = { 0 };
         size_t sop = 0, pop = 0, eop = 0;
@@ -77,6 +95,8 @@ public:
         std::cout <<      "|" << (eop * 1000.0 / edu) << ")";
         std::cout << std::endl;
         std::cout.copyfmt(ff);
+        for (const std::string& line : notes) std::cout << "\t" << line << std::endl;
+        notes.clear();
 
         if (!tstat) return;
         for (size_t t = 0, c = 0; c < blk; c += stat[t++]) {
@@ -90,26 +110,171 @@ public:
         std::cout << std::endl;
     }
 
-    void summary() const {
+    /**
+     * machine-readable record of the last 'block' games, for --export
+     *
+     * in json, one line per block, e.g.
+     * {"episode":1000,"avg":318,"max":1514,"ops":401934,"ops_player":4216043,"ops_env":218194,
+     *  "reach":{"32":1,"64":0.985,...},"latency":{"p50":3,"p90":5,"p99":9},"wall":2410,"time":1792364405123}
+     *
+     * in prometheus text format, the whole content of a textfile collector file, e.g.
+     * tcg_episode 1000
+     * tcg_score{stat="avg"} 318
+     * tcg_reach_rate{tile="64"} 0.985
+     * tcg_latency_ms{quantile="0.5"} 3
+     * ...
+     *
+     * where 'latency' is the percentile of episode duration (ms),
+     * and 'wall' is the wall time of the block (ms)
+     */
+    std::string record(bool prom = false) const {
+        size_t blk = std::min(data.size(), block);
+        size_t stat[64] = { 0 };
+        size_t sop = 0, pop = 0, eop = 0;
+        time_t sdu = 0, pdu = 0, edu = 0;
+        board::reward sum = 0, max = 0;
+        std::vector<time_t> lat;
+        time_t first = 0, last = 0;
+        auto it = data.end();
+        for (size_t i = 0; i < blk; i++) {
+            auto& ep = *(--it);
+            sum += ep.score();
+            max = std::max(ep.score(), max);
+            stat[*std::max_element(&(ep.state()(0)), &(ep.state()(16)))]++;
+            sop += ep.step();
+            pop += ep.step(action::slide::type);
+            eop += ep.step(action::place::type);
+            sdu += ep.time();
+            pdu += ep.time(action::slide::type);
+            edu += ep.time(action::place::type);
+            lat.push_back(ep.time());
+            first = i ? std::min(first, ep.ep_open.when) : ep.ep_open.when;
+            last = std::max(last, ep.ep_close.when);
+        }
+        std::sort(lat.begin(), lat.end());
+        auto pct = [&](double p) { return lat.size() ? lat[std::min(lat.size() - 1, size_t(p * lat.size()))] : 0; };
+        auto ops = [](size_t op, time_t du) { return du ? op * 1000.0 / du : 0.0; };
+
+        std::stringstream ss;
+        ss << std::fixed << std::setprecision(0);
+        if (!prom) {
+            ss << "{\"episode\":" << count;
+            ss << ",\"avg\":" << (blk ? sum / blk : 0) << ",\"max\":" << max;
+            ss << ",\"ops\":" << ops(sop, sdu) << ",\"ops_player\":" << ops(pop, pdu) << ",\"ops_env\":" << ops(eop, edu);
+            ss << std::setprecision(4) << ",\"reach\":{";
+            for (size_t t = 0, c = 0, n = 0; c < blk; c += stat[t++]) {
+                if (stat[t] == 0) continue;
+                unsigned accu = std::accumulate(std::begin(stat) + t, std::end(stat), 0);
+                ss << (n++ ? "," : "") << "\"" << ((1 << t) & -2u) << "\":" << (accu * 1.0 / blk);
+            }
+            ss << "}";
+            ss << ",\"latency\":{\"p50\":" << pct(0.5) << ",\"p90\":" << pct(0.9) << ",\"p99\":" << pct(0.99) << "}";
+            ss << ",\"wall\":" << (last - first) << ",\"time\":" << last;
+            ss << "}" << std::endl;
+        } else {
+            ss << "# TYPE tcg_episode counter" << std::endl;
+            ss << "tcg_episode " << count << std::endl;
+            ss << "# TYPE tcg_score gauge" << std::endl;
+            ss << "tcg_score{stat=\"avg\"} " << (blk ? sum / blk : 0) << std::endl;
+            ss << "tcg_score{stat=\"max\"} " << max << std::endl;
+            ss << "# TYPE tcg_ops gauge" << std::endl;
+            ss << "tcg_ops{agent=\"all\"} " << ops(sop, sdu) << std::endl;
+            ss << "tcg_ops{agent=\"player\"} " << ops(pop, pdu) << std::endl;
+            ss << "tcg_ops{agent=\"environment\"} " << ops(eop, edu) << std::endl;
+            ss << "# TYPE tcg_reach_rate gauge" << std::endl;
+            ss << std::setprecision(4);
+            for (size_t t = 0, c = 0; c < blk; c += stat[t++]) {
+                if (stat[t] == 0) continue;
+                unsigned accu = std::accumulate(std::begin(stat) + t, std::end(stat), 0);
+                ss << "tcg_reach_rate{tile=\"" << ((1 << t) & -2u) << "\"} " << (accu * 1.0 / blk) << std::endl;
+            }
+            ss << "# TYPE tcg_latency_ms summary" << std::endl;
+            ss << "tcg_latency_ms{quantile=\"0.5\"} " << pct(0.5) << std::endl;
+            ss << "tcg_latency_ms{quantile=\"0.9\"} " << pct(0.9) << std::endl;
+            ss << "tcg_latency_ms{quantile=\"0.99\"} " << pct(0.99) << std::endl;
+            ss << "# TYPE tcg_block_wall_ms gauge" << std::endl;
+            ss << "tcg_block_wall_ms " << (last - first) << std::endl;
+        }
+        return ss.str();
+    }
+
+    /**
+     * export a record of every block to path (see record)
+     * json lines are appended to the file, while a prometheus file (*.prom) is
+     * replaced by the latest block as the textfile collector expects
+     */
+    void exports(const std::string& path) {
+        prom = path.size() >= 5 && path.compare(path.size() - 5, 5, ".prom") == 0;
+        out.reset(new writer(path, prom ? writer::replace : writer::append));
+    }
+
+    /**
+     * save every episode to path as it closes, one line per episode (see operator <<),
+     * after the episodes already held (e.g. given by --load)
+     * the lines are appended by a background thread (see writer), so an abrupt stop loses
+     * the lines still queued, i.e., the episodes closed since its last write, and the truncated
+     * remains of a line being written, which are skipped by operator >>
+     * a path ending with '.cz' is saved as a block-compressed archive instead (see archive),
+     * where a block is written at the end of each statistic block or every archive::block_size bytes
+     */
+    void saves(const std::string& path) {
+        log.reset(new writer(path, writer::append, true));
+        packed = archive::named(path);
+        if (packed) {
+            log->write(archive::signature());
+            for (const episode& rec : data) {
+                pack(rec);
+                if (pending.size() >= archive::block_size()) flush();
+            }
+            flush();
+            return;
+        }
+        std::stringstream ss;
+        ss << *this;
+        log->write(ss.str());
+    }
+
+    void summary() {
         auto block_temp = block;
-        const_cast<statistic&>(*this).block = data.size();
+        block = data.size();
         show();
-        const_cast<statistic&>(*this).block = block_temp;
+        block = block_temp;
     }
 
     bool is_finished() const {
         return count >= total;
     }
 
+    bool is_block_end() const {
+        return count % block == 0;
+    }
+
     void open_episode(const std::string& flag = "") {
         if (count++ >= limit) data.pop_front();
         data.emplace_back();
         data.back().open_episode(flag);
     }
 
+    /**
+     * attach extra lines (one per line break) to the output of the next block
+     */
+    void annotate(const std::string& line) {
+        std::stringstream ss(line);
+        for (std::string each; std::getline(ss, each); ) if (each.size()) notes.push_back(each);
+    }
+
     void close_episode(const std::string& flag = "") {
         data.back().close_episode(flag);
-        if (count % block == 0) show();
+        if (log && packed) {
+            pack(data.back());
+            if (is_block_end() || pending.size() >= archive::block_size()) flush();
+        } else if (log) {
+            std::stringstream ss;
+            ss << data.back() << std::endl;
+            log->write(ss.str());
+        }
+        if (is_block_end()) show();
+        if (is_block_end() && out) out->write(record(prom));
     }
 
     episode& at(size_t i) {
@@ -123,6 +288,104 @@ public:
     episode& back() {
         return data.back();
     }
+    std::list<episode>::const_iterator begin() const {
+        return data.begin();
+    }
+    std::list<episode>::const_iterator end() const {
+        return data.end();
+    }
+
+    /**
+     * load the episodes of a file as operator >> does, for large logs:
+     * the file is mapped into memory and split at line boundaries into chunks,
+     * which are parsed and replayed by threads (see episode::parse) and merged in order
+     * return false if the file cannot be mapped
+     */
+    bool load(const std::string& path, unsigned threads = std::thread::hardware_concurrency()) {
+        if (archive::detect(path)) return unpack(path, threads);
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct ::stat st;
+        if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+            ::close(fd);
+            return false;
+        }
+        size_t size = st.st_size;
+        void* map = size ? ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : nullptr;
+        ::close(fd);
+        if (map == MAP_FAILED) return false;
+        ::madvise(map, size, MADV_SEQUENTIAL);
+        const char* text = static_cast<const char*>(map);
+
+        struct chunk {
+            const char* first;
+            const char* last;
+            std::list<episode> data;
+            bool stop; // reached an empty line, where operator >> stops
+        };
+        threads = std::max(1u, threads);
+        std::vector<chunk> chunks;
+        for (size_t n = threads * 4, i = 0, begin = 0; begin < size; i++) {
+            size_t end = std::max(begin + 1, std::min(size, size * (i + 1) / n));
+            while (end < size && text[end - 1] != '\n') end++;
+            chunks.push_back({ text + begin, text + end, {}, false });
+            begin = end;
+        }
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; t++) {
+            workers.emplace_back([&]() {
+                for (size_t k; (k = next++) < chunks.size(); ) {
+                    chunk& c = chunks[k];
+                    c.stop = parse(c.first, c.last, c.data);
+                }
+            });
+        }
+        for (std::thread& w : workers) w.join();
+        for (chunk& c : chunks) {
+            data.splice(data.end(), c.data);
+            if (c.stop) break;
+        }
+        if (map) ::munmap(map, size);
+        total = std::max(total, data.size());
+        count = data.size();
+        return true;
+    }
+
+    /**
+     * load the episodes of a block-compressed file (see archive), for each round
+     * a block per thread is read, decoded and parsed by the threads, and merged in order,
+     * so the memory besides the episodes is bounded by the blocks of a round
+     */
+    bool unpack(const std::string& path, unsigned threads) {
+        archive::reader in(path);
+        if (!in.good()) return false;
+        threads = std::max(1u, threads);
+        std::vector<archive::block> blocks(threads);
+        std::vector<std::list<episode>> lists(threads);
+        std::vector<char> stops(threads);
+        for (bool stop = false; !stop; ) {
+            size_t n = 0;
+            while (n < threads && in.next(blocks[n])) n++;
+            if (n == 0) break;
+            std::vector<std::thread> workers;
+            for (size_t k = 0; k < n; k++) {
+                workers.emplace_back([&, k]() {
+                    std::string text = blocks[k].unpack();
+                    stops[k] = parse(text.data(), text.data() + text.size(), lists[k]);
+                });
+            }
+            for (std::thread& w : workers) w.join();
+            for (size_t k = 0; k < n && !stop; k++) {
+                data.splice(data.end(), lists[k]);
+                stop = stops[k];
+            }
+            stop |= n < threads;
+        }
+        total = std::max(total, data.size());
+        count = data.size();
+        return true;
+    }
 
     friend std::ostream& operator <<(std::ostream& out, const statistic& stat) {
         for (const episode& rec : stat.data) out << rec << std::endl;
@@ -130,6 +393,7 @@ public:
     }
     friend std::istream& operator >>(std::istream& in, statistic& stat) {
         for (std::string line; std::getline(in, line) && line.size(); ) {
+            if (in.eof()) break; // the truncated last line of an interrupted save
             stat.data.emplace_back();
             std::stringstream(line) >> stat.data.back();
         }
@@ -138,10 +402,51 @@ public:
         return in;
     }
 
+protected:
+    /**
+     * parse the lines [first, last) into episodes, appended to data
+     * return true if an empty line is reached, where operator >> stops
+     */
+    static bool parse(const char* first, const char* last, std::list<episode>& data) {
+        for (const char* p = first; p < last; ) {
+            const char* eol = std::find(p, last, '\n');
+            if (eol == last) break; // the truncated last line of an interrupted save
+            if (eol == p) return true;
+            data.emplace_back();
+            if (!data.back().parse(p, eol)) data.pop_back();
+            p = eol + 1;
+        }
+        return false;
+    }
+
+    /**
+     * queue an episode into the pending block, and write the block as a whole,
+     * compressed by the i/o thread of the writer rather than the playing thread
+     */
+    void pack(const episode& rec) {
+        std::stringstream ss;
+        ss << rec << std::endl;
+        pending += ss.str();
+        lines++;
+    }
+    void flush() {
+        size_t n = lines;
+        if (n) log->write(std::move(pending), [n](const std::string& text) { return archive::pack(text, n); });
+        pending.clear();
+        lines = 0;
+    }
+
 private:
     size_t total;
     size_t block;
     size_t limit;
     size_t count;
     std::list<episode> data;
+    std::vector<std::string> notes;
+    std::unique_ptr<writer> out;
+    std::unique_ptr<writer> log;
+    bool prom;
+    bool packed;
+    std::string pending;
+    size_t lines;
 };
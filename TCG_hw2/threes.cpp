@@ -0,0 +1,107 @@
+/**
+ * C Interface of the Game Engine, see threes.h
+ * use 'make libthrees' to build libthrees.so
+ */
+
+#include <stdexcept>
+#include "threes.h"
+#include "board.h"
+#include "agent.h"
+#include "batch.h"
+
+struct threes_batch : lockstep {
+    threes_batch(size_t n, uint64_t seed) : lockstep(seed) {
+        for (size_t i = 0; i < n; i++) spawn(i);
+    }
+
+    void expand(uint8_t* legal, uint64_t* after, int32_t* reward) const {
+        uint64_t a[4];
+        int r[4];
+        for (size_t i = 0; i < boards.size(); i++) {
+            unsigned l = slide(boards[i], a, r);
+            if (legal) legal[i] = l;
+            for (unsigned op = 0; op < 4; op++) {
+                bool ok = l & (1u << op);
+                if (after) after[i * 4 + op] = ok ? a[op] : boards[i];
+                if (reward) reward[i * 4 + op] = ok ? r[op] : -1;
+            }
+        }
+    }
+
+    void step(const uint8_t* action, int32_t* reward, uint8_t* over) {
+        uint64_t a[4];
+        int r[4];
+        for (size_t i = 0; i < boards.size(); i++) {
+            int32_t gain = -1;
+            unsigned op = action[i];
+            if (!done[i] && op < 4 && (slide(boards[i], a, r) & (1u << op))) {
+                boards[i] = a[op];
+                score[i] += r[op];
+                last[i] = op;
+                gain = r[op];
+                done[i] = !place(i) || !slide(boards[i], a, r);
+            }
+            if (reward) reward[i] = gain;
+            if (over) over[i] = done[i];
+        }
+    }
+
+    const uint64_t* data() const { return boards.data(); }
+};
+
+struct threes_net {
+    threes_net(const std::string& args) : play(args) {}
+    player play;
+};
+
+extern "C" {
+
+threes_batch* threes_batch_create(size_t n, uint64_t seed) {
+    try {
+        return new threes_batch(n, seed);
+    } catch (std::exception&) {
+        return nullptr;
+    }
+}
+
+void threes_batch_destroy(threes_batch* b) {
+    delete b;
+}
+
+size_t threes_batch_size(const threes_batch* b) {
+    return b->size();
+}
+
+void threes_batch_reset(threes_batch* b, size_t i, uint64_t episode) {
+    if (i < b->size()) b->reset(i, episode);
+}
+
+const uint64_t* threes_batch_boards(const threes_batch* b) {
+    return b->data();
+}
+
+void threes_batch_expand(const threes_batch* b, uint8_t* legal, uint64_t* after, int32_t* reward) {
+    b->expand(legal, after, reward);
+}
+
+void threes_batch_step(threes_batch* b, const uint8_t* action, int32_t* reward, uint8_t* done) {
+    b->step(action, reward, done);
+}
+
+threes_net* threes_net_create(const char* args) {
+    try {
+        return new threes_net(args ? args : "");
+    } catch (std::exception&) {
+        return nullptr;
+    }
+}
+
+void threes_net_destroy(threes_net* net) {
+    delete net;
+}
+
+void threes_net_evaluate(const threes_net* net, const uint64_t* boards, size_t n, float* value) {
+    net->play.get_board_value(boards, n, value);
+}
+
+}
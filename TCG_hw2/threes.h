@@ -0,0 +1,74 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * C interface of the engine, built as libthrees.so (see makefile)
+ *
+ * a board is exchanged as a packed uint64 (see board::pack), 4 bits per cell in 1-d form order,
+ * so the games of a batch cannot merge two 15-tiles, and such a slide is illegal
+ * opcodes are 0: up, 1: right, 2: down, 3: left
+ * all results are written to buffers given by the caller, nothing is allocated per call
+ */
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct threes_batch threes_batch;
+typedef struct threes_net threes_net;
+
+/**
+ * create a batch of n games with the environment seed, game i is started as episode i
+ * return null if the games cannot be allocated; destroy releases it
+ */
+threes_batch* threes_batch_create(size_t n, uint64_t seed);
+void threes_batch_destroy(threes_batch* b);
+
+/**
+ * the number of games
+ */
+size_t threes_batch_size(const threes_batch* b);
+
+/**
+ * restart game i as the given episode, with the 9 initial tiles placed
+ * the episode selects the random stream, so the same (seed, episode) gives the same game
+ */
+void threes_batch_reset(threes_batch* b, size_t i, uint64_t episode);
+
+/**
+ * the n current boards, held by the batch and valid until its next step, reset or destroy
+ */
+const uint64_t* threes_batch_boards(const threes_batch* b);
+
+/**
+ * the legal slides of each game: legal[i] is the bitmask of legal opcodes,
+ * after[4 * i + op] and reward[4 * i + op] are the after-state and reward of slide op
+ * (the after-state is the board itself and the reward is -1 if the slide is illegal)
+ * any of the buffers may be null
+ */
+void threes_batch_expand(const threes_batch* b, uint8_t* legal, uint64_t* after, int32_t* reward);
+
+/**
+ * apply action[i] to game i and place the next tile
+ * reward[i] is the reward of the slide, or -1 if it is illegal (the game is unchanged)
+ * done[i] is 1 if game i has no legal slide afterwards, the games already done are not changed
+ * reward and done may be null
+ */
+void threes_batch_step(threes_batch* b, const uint8_t* action, int32_t* reward, uint8_t* done);
+
+/**
+ * load a network with the player arguments, e.g. "load=weights.bin" or "net=spec.txt load=weights.bin"
+ * return null if the weights or the spec cannot be read
+ * destroy saves the weights if save= is given, an error is then reported to stderr
+ */
+threes_net* threes_net_create(const char* args);
+void threes_net_destroy(threes_net* net);
+
+/**
+ * the values of n after-states
+ */
+void threes_net_evaluate(const threes_net* net, const uint64_t* boards, size_t n, float* value);
+
+#ifdef __cplusplus
+}
+#endif
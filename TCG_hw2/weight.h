@@ -11,36 +11,165 @@
 #include <iostream>
 #include <vector>
 #include <utility>
+#include <algorithm>
+#include <cstdint>
+#include "allocator.h"
 
+/**
+ * a weight table, either dense (a float per index) or hashed
+ *
+ * a hashed table stands for a table of size() entries, but holds at most capacity() of them
+ * in an open-addressing hash table of 64-byte buckets, each of 4 keys, 4 values, and 4 stamps;
+ * a key is looked up only in its own bucket (one cache line), a missing key reads as 0,
+ * and an update of a missing key takes an empty slot of the bucket, or evicts its entry
+ * updated least recently (by the update clock of the table), so cold entries age out;
+ * the stamps are saved with the table, while the count of evictions is not and starts
+ * over from 0 when the table is loaded
+ *
+ * operator[] and data() are for dense tables; find(), add(), and slot() work on both
+ */
 class weight {
 public:
-    weight() {}
-    weight(size_t len) : value(len) {}
-    weight(weight&& f) : value(std::move(f.value)) {}
+    weight() : length(0), bits(0), clock(0), used(0), evicted(0) {}
+    weight(size_t len, size_t capacity = 0) : length(0), bits(0), clock(0), used(0), evicted(0) {
+        if (capacity) reserve(len, capacity);
+        else value.resize(len);
+    }
+    weight(weight&& f) = default;
     weight(const weight& f) = default;
 
     weight& operator =(const weight& f) = default;
+    weight& operator =(weight&& f) = default;
     float& operator[] (size_t i) { return value[i]; }
     const float& operator[] (size_t i) const { return value[i]; }
-    size_t size() const { return value.size(); }
+    size_t size() const { return hashed() ? length : value.size(); }
+    const float* data() const { return value.data(); }
+
+public:
+    bool hashed() const { return table.size(); }
+    size_t capacity() const { return table.size() * ways; }
+    size_t entries() const { return used; }
+    size_t evictions() const { return evicted; }
+
+    float find(size_t i) const {
+        if (!hashed()) return value[i];
+        const bucket& b = table[home(i)];
+        for (unsigned k = 0; k < ways; k++)
+            if (b.key[k] == i + 1) return b.value[k];
+        return 0;
+    }
+    void add(size_t i, float u) {
+        if (!hashed()) {
+            value[i] += u;
+            return;
+        }
+        bucket& b = table[home(i)];
+        clock++;
+        unsigned victim = 0;
+        for (unsigned k = 0; k < ways; k++) {
+            if (b.key[k] == i + 1) {
+                b.value[k] += u;
+                b.stamp[k] = clock;
+                return;
+            }
+            if (b.key[victim] && (!b.key[k] || int32_t(b.stamp[k] - b.stamp[victim]) < 0)) victim = k;
+        }
+        if (b.key[victim]) evicted++;
+        else used++;
+        b.key[victim] = i + 1;
+        b.value[victim] = u;
+        b.stamp[victim] = clock;
+    }
+    /**
+     * the address where index i is stored, for prefetching
+     */
+    const void* slot(size_t i) const {
+        return hashed() ? static_cast<const void*>(&table[home(i)]) : static_cast<const void*>(value.data() + i);
+    }
+
+    /**
+     * the serialized form of the table, the header words (returned, 1 or 2) and then the raw bytes;
+     * a dense table is its size and the values, a hashed table is its size with the top bit set,
+     * the number of buckets, and the buckets
+     */
+    size_t header(uint64_t* head) const {
+        if (!hashed()) return head[0] = value.size(), 1;
+        head[0] = length | flag;
+        head[1] = table.size();
+        return 2;
+    }
+    const char* raw() const {
+        return hashed() ? reinterpret_cast<const char*>(table.data()) : reinterpret_cast<const char*>(value.data());
+    }
+    size_t raw_size() const {
+        return hashed() ? sizeof(bucket) * table.size() : sizeof(float) * value.size();
+    }
+    static bool is_hashed(uint64_t head) { return head & flag; }
 
 public:
     friend std::ostream& operator <<(std::ostream& out, const weight& w) {
-        auto& value = w.value;
-        uint64_t size = value.size();
-        out.write(reinterpret_cast<const char*>(&size), sizeof(uint64_t));
-        out.write(reinterpret_cast<const char*>(value.data()), sizeof(float) * size);
+        uint64_t head[2];
+        out.write(reinterpret_cast<const char*>(head), sizeof(uint64_t) * w.header(head));
+        out.write(w.raw(), w.raw_size());
         return out;
     }
     friend std::istream& operator >>(std::istream& in, weight& w) {
-        auto& value = w.value;
         uint64_t size = 0;
         in.read(reinterpret_cast<char*>(&size), sizeof(uint64_t));
+        if (is_hashed(size)) {
+            uint64_t buckets = 0;
+            in.read(reinterpret_cast<char*>(&buckets), sizeof(uint64_t));
+            w = weight();
+            w.length = size & ~flag;
+            w.table.resize(buckets);
+            in.read(reinterpret_cast<char*>(w.table.data()), sizeof(bucket) * buckets);
+            w.bits = __builtin_ctzll(std::max<uint64_t>(buckets, 1));
+            for (const bucket& b : w.table) { // resume the clock after the latest stamp, so the loaded entries age as before
+                for (unsigned k = 0; k < ways; k++) {
+                    if (!b.key[k]) continue;
+                    if (!w.used++ || int32_t(b.stamp[k] - w.clock) > 0) w.clock = b.stamp[k];
+                }
+            }
+            return in;
+        }
+        auto& value = w.value;
+        w.table.clear();
         value.resize(size);
         in.read(reinterpret_cast<char*>(value.data()), sizeof(float) * size);
         return in;
     }
 
 protected:
-    std::vector<float> value;
+    static constexpr unsigned ways = 4;
+    static constexpr uint64_t flag = 1ull << 63;
+
+    /**
+     * keys are stored as index + 1, so the zero pages of a new table are empty buckets
+     */
+    struct bucket {
+        uint64_t key[ways];
+        float value[ways];
+        uint32_t stamp[ways];
+    };
+    static_assert(sizeof(bucket) == 64, "a bucket takes a cache line");
+
+    void reserve(size_t len, size_t capacity) {
+        size_t buckets = 1;
+        while (buckets * ways < capacity) buckets <<= 1;
+        length = len;
+        bits = __builtin_ctzll(buckets);
+        table.resize(buckets);
+    }
+    size_t home(size_t i) const {
+        return bits ? (uint64_t(i) * 0x9e3779b97f4a7c15ull) >> (64 - bits) : 0;
+    }
+
+protected:
+    std::vector<float, lazy_allocator<float>> value;
+    std::vector<bucket, lazy_allocator<bucket>> table;
+    size_t length;
+    unsigned bits;
+    uint32_t clock;
+    size_t used;
+    size_t evicted;
 };
@@ -0,0 +1,101 @@
+#pragma once
+#include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <fstream>
+#include <cstdio>
+
+/**
+ * buffered file writer running on a background i/o thread
+ *
+ * write() only queues the data, so the caller never waits for the disk;
+ * the queued data is written in order, and each piece is flushed as a whole;
+ * a piece may come with an encoder (e.g. a compressor), which also runs on the i/o thread
+ *
+ * in append mode, the pieces are appended to the file
+ * in replace mode, each piece replaces the whole file atomically (via 'path.tmp')
+ */
+class writer {
+public:
+    enum mode { append, replace };
+
+    writer(const std::string& path, mode how = append, bool truncate = false) : path(path), how(how), closing(false), pending(0) {
+        if (how == append) file.open(path, std::ios::out | std::ios::binary | (truncate ? std::ios::trunc : std::ios::app));
+        worker = std::thread(&writer::run, this);
+    }
+    ~writer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closing = true;
+        }
+        cv.notify_all();
+        worker.join();
+    }
+
+public:
+    typedef std::function<std::string(const std::string&)> encoder;
+
+    void write(std::string data, encoder encode = nullptr) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back({ std::move(data), std::move(encode) });
+            pending++;
+        }
+        cv.notify_all();
+    }
+
+    /**
+     * block until all queued data is on the file
+     */
+    void flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]() { return pending == 0; });
+    }
+
+    bool good() const { return how == replace || file.good(); }
+
+protected:
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            cv.wait(lock, [this]() { return closing || queue.size(); });
+            if (queue.empty()) break;
+            std::deque<piece> batch;
+            batch.swap(queue);
+            lock.unlock();
+            if (how == append) {
+                for (const piece& p : batch) file << p.text();
+                file.flush();
+            } else {
+                std::ofstream out(path + ".tmp", std::ios::out | std::ios::trunc);
+                out << batch.back().text();
+                out.close();
+                std::rename((path + ".tmp").c_str(), path.c_str());
+            }
+            lock.lock();
+            pending -= batch.size();
+            done.notify_all();
+        }
+    }
+
+private:
+    struct piece {
+        std::string data;
+        encoder encode;
+        std::string text() const { return encode ? encode(data) : data; }
+    };
+
+    std::string path;
+    mode how;
+    std::ofstream file;
+    std::deque<piece> queue;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::condition_variable done;
+    bool closing;
+    size_t pending;
+    std::thread worker;
+};
@@ -0,0 +1,311 @@
+#pragma once
+#include <array>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdint>
+#include "rule.h"
+
+#ifndef COUNT
+#define COUNT(e, n) ((void) 0) // the event counters of the program (e.g. counter.h of hw2), if it has them
+#endif
+
+/**
+ * array-based board for 2048
+ *
+ * index (1-d form):
+ *  (0)  (1)  (2)  (3)
+ *  (4)  (5)  (6)  (7)
+ *  (8)  (9) (10) (11)
+ * (12) (13) (14) (15)
+ *
+ * the reward of merging tiles is given by the reward rule (see rule.h),
+ * so each variant has its own slides and lookup tables generated from the same code
+ */
+template<class reward_rule>
+class basic_board {
+public:
+    typedef basic_board board;
+    typedef uint32_t cell;
+    typedef std::array<cell, 4> row;
+    typedef std::array<row, 4> grid;
+    typedef uint64_t data;
+    typedef int reward;
+
+public:
+    basic_board() : tile(), attr(0) {}
+    basic_board(const grid& b, data v = 0) : tile(b), attr(v) {}
+    basic_board(const basic_board& b) = default;
+    basic_board& operator =(const basic_board& b) = default;
+
+    operator grid&() { return tile; }
+    operator const grid&() const { return tile; }
+    row& operator [](unsigned i) { return tile[i]; }
+    const row& operator [](unsigned i) const { return tile[i]; }
+    cell& operator ()(unsigned i) { return tile[i / 4][i % 4]; }
+    const cell& operator ()(unsigned i) const { return tile[i / 4][i % 4]; }
+
+    data info() const { return attr; }
+    data info(data dat) { data old = attr; attr = dat; return old; }
+
+    /**
+     * packed form of the board, 4 bits per cell (cell i at bit 4i), tiles are clipped at 15
+     */
+    uint64_t pack() const {
+        uint64_t v = 0;
+        for (int i = 0; i < 16; i++) v |= uint64_t(std::min<cell>(operator()(i), 15)) << (4 * i);
+        return v;
+    }
+    static board unpack(uint64_t v) {
+        board b;
+        for (int i = 0; i < 16; i++) b(i) = (v >> (4 * i)) & 0x0f;
+        return b;
+    }
+
+public:
+    bool operator ==(const board& b) const { return tile == b.tile; }
+    bool operator < (const board& b) const { return tile <  b.tile; }
+    bool operator !=(const board& b) const { return !(*this == b); }
+    bool operator > (const board& b) const { return b < *this; }
+    bool operator <=(const board& b) const { return !(b < *this); }
+    bool operator >=(const board& b) const { return !(*this < b); }
+
+public:
+
+    /**
+     * place a tile (index value) to the specific position (1-d form index)
+     * return 0 if the action is valid, or -1 if not
+     */
+    reward place(unsigned pos, cell tile) {
+        if (pos >= 16) return -1;
+        if (tile != 1 && tile != 2 && tile != 3) return -1;
+        operator()(pos) = tile;
+        return 0;
+    }
+
+    /**
+     * apply an action to the board
+     * return the reward of the action, or -1 if the action is illegal
+     */
+    reward slide(unsigned opcode) {
+        reward score = -1;
+        switch (opcode & 0b11) {
+        case 0: score = slide_up(); break;
+        case 1: score = slide_right(); break;
+        case 2: score = slide_down(); break;
+        case 3: score = slide_left(); break;
+        }
+        COUNT(move, 1);
+        COUNT(illegal, score == -1);
+        return score;
+    }
+
+    reward slide_left() {
+        board prev = *this;
+        reward score = 0;
+        for (int r = 0; r < 4; r++) {
+            auto& row = tile[r];
+            ////
+            for (int c = 0; c < 3; c++) {
+                if (row[c] == 0) {
+                    row[c] = row[c+1];
+                    row[c+1] = 0;
+                } else if ((row[c] == 1 && row[c+1] == 2) || (row[c] == 2 && row[c+1] == 1)) {
+                    row[c] = 3;
+                    row[c+1] = 0;
+                    score+=reward_rule::pair();
+                } else if (row[c] > 2 && row[c] == row[c+1]) {
+                    row[c]++;
+                    row[c+1] = 0;
+                    score+=reward_rule::merge(row[c]);
+                }
+            }
+            ////
+        }
+        return (*this != prev) ? score : -1;
+    }
+    reward slide_right() {
+        reflect_horizontal();
+        reward score = slide_left();
+        reflect_horizontal();
+        return score;
+    }
+    reward slide_up() {
+        rotate_right();
+        reward score = slide_right();
+        rotate_left();
+        return score;
+    }
+    reward slide_down() {
+        rotate_right();
+        reward score = slide_left();
+        rotate_left();
+        return score;
+    }
+
+    /**
+     * slide the board in all four directions at once (see moves)
+     */
+    struct moves;
+    moves expand() const;
+
+    void transpose() {
+        for (int r = 0; r < 4; r++) {
+            for (int c = r + 1; c < 4; c++) {
+                std::swap(tile[r][c], tile[c][r]);
+            }
+        }
+    }
+
+    void reflect_horizontal() {
+        for (int r = 0; r < 4; r++) {
+            std::swap(tile[r][0], tile[r][3]);
+            std::swap(tile[r][1], tile[r][2]);
+        }
+    }
+
+    void reflect_vertical() {
+        for (int c = 0; c < 4; c++) {
+            std::swap(tile[0][c], tile[3][c]);
+            std::swap(tile[1][c], tile[2][c]);
+        }
+    }
+
+    /**
+     * rotate the board clockwise by given times
+     */
+    void rotate(int r = 1) {
+        switch (((r % 4) + 4) % 4) {
+        default:
+        case 0: break;
+        case 1: rotate_right(); break;
+        case 2: reverse(); break;
+        case 3: rotate_left(); break;
+        }
+    }
+
+    void rotate_right() { transpose(); reflect_horizontal(); } // clockwise
+    void rotate_left() { transpose(); reflect_vertical(); } // counterclockwise
+    void reverse() { reflect_horizontal(); reflect_vertical(); }
+
+public:
+    friend std::ostream& operator <<(std::ostream& out, const board& b) {
+        out << "+------------------------+" << std::endl;
+        for (auto& row : b.tile) {
+            out << "|" << std::dec;
+            for (auto t : row) out << std::setw(6) << ((1 << t) & -2u);
+            out << "|" << std::endl;
+        }
+        out << "+------------------------+" << std::endl;
+        return out;
+    }
+
+public:
+    /**
+     * precomputed slides of a line of 4 cells, each cell packed in 4 bits (cell k at bit 4k)
+     *  line[0], score[0]: the line and the reward after sliding toward cell 0 (left or up)
+     *  line[1], score[1]: the line and the reward after sliding toward cell 3 (right or down)
+     *  move:              bit 0 is set if the line can slide toward cell 0, bit 1 toward cell 3;
+     *                     bit 2 is set if the slide toward cell 0 merges into a 16, which does not fit
+     *                     in 4 bits (the line and reward are then left as is), bit 3 toward cell 3
+     */
+    struct lookup {
+        struct entry {
+            uint16_t line[2];
+            typename reward_rule::score score[2];
+            uint8_t move;
+        };
+        std::array<entry, 65536> lines;
+
+        lookup() {
+            for (unsigned l = 0; l < 65536; l++) {
+                board b;
+                for (int k = 0; k < 4; k++) b.tile[0][k] = (l >> (k * 4)) & 0x0f;
+                board left = b, right = b;
+                reward sl = left.slide_left(), sr = right.slide_right();
+                auto& e = lines[l];
+                bool wide[2] = { *std::max_element(left.tile[0].begin(), left.tile[0].end()) >= 16,
+                                 *std::max_element(right.tile[0].begin(), right.tile[0].end()) >= 16 };
+                e.line[0] = wide[0] ? l : line(left.tile[0][0], left.tile[0][1], left.tile[0][2], left.tile[0][3]);
+                e.line[1] = wide[1] ? l : line(right.tile[0][0], right.tile[0][1], right.tile[0][2], right.tile[0][3]);
+                e.score[0] = wide[0] ? 0 : std::max(sl, 0);
+                e.score[1] = wide[1] ? 0 : std::max(sr, 0);
+                e.move = (sl != -1 ? 1 : 0) | (sr != -1 ? 2 : 0) | (wide[0] ? 4 : 0) | (wide[1] ? 8 : 0);
+            }
+        }
+        static const lookup& table() { static const lookup t; return t; }
+    };
+
+protected:
+    static unsigned line(cell a, cell b, cell c, cell d) {
+        return a | (b << 4) | (c << 8) | (d << 12);
+    }
+
+    /**
+     * whether the rows and columns can be looked up, i.e., no tile is 15 or larger,
+     * since two 15-tiles merge into a 16 which the table cannot hold
+     */
+    bool packable() const {
+        for (auto& row : tile) for (auto t : row) if (t >= 15) return false;
+        return true;
+    }
+
+private:
+    grid tile;
+    data attr;
+};
+
+/**
+ * the results of all four slides, computed in one pass
+ *  after[op]: the after-state of opcode op
+ *  score[op]: the reward of opcode op, or -1 if it is illegal
+ *  legal:     bitmask of the legal opcodes (bit op is set if op is legal)
+ */
+template<class reward_rule>
+struct basic_board<reward_rule>::moves {
+    std::array<board, 4> after;
+    std::array<reward, 4> score;
+    unsigned legal;
+    bool over() const { return legal == 0; }
+};
+
+/**
+ * slide the board in all four directions at once with the row lookup tables
+ * each row and column is looked up once, instead of sliding four copies
+ */
+template<class reward_rule>
+inline typename basic_board<reward_rule>::moves basic_board<reward_rule>::expand() const {
+    moves m;
+    m.legal = 0;
+    if (!packable()) {
+        for (unsigned op = 0; op < 4; op++) {
+            m.after[op] = *this;
+            m.score[op] = m.after[op].slide(op);
+            m.legal |= (m.score[op] != -1) << op;
+        }
+        return m;
+    }
+    const lookup& t = lookup::table();
+    for (unsigned op = 0; op < 4; op++) m.after[op].attr = attr, m.score[op] = 0;
+    for (int i = 0; i < 4; i++) {
+        unsigned row = line(tile[i][0], tile[i][1], tile[i][2], tile[i][3]);
+        unsigned col = line(tile[0][i], tile[1][i], tile[2][i], tile[3][i]);
+        const typename lookup::entry& r = t.lines[row];
+        const typename lookup::entry& c = t.lines[col];
+        for (int k = 0; k < 4; k++) {
+            m.after[3].tile[i][k] = (r.line[0] >> (k * 4)) & 0x0f;
+            m.after[1].tile[i][k] = (r.line[1] >> (k * 4)) & 0x0f;
+            m.after[0].tile[k][i] = (c.line[0] >> (k * 4)) & 0x0f;
+            m.after[2].tile[k][i] = (c.line[1] >> (k * 4)) & 0x0f;
+        }
+        m.score[3] += r.score[0], m.score[1] += r.score[1];
+        m.score[0] += c.score[0], m.score[2] += c.score[1];
+        m.legal |= ((r.move & 1) << 3) | (r.move & 2) | (c.move & 1) | ((c.move & 2) << 1);
+    }
+    for (unsigned op = 0; op < 4; op++) {
+        if (!(m.legal & (1u << op))) m.score[op] = -1;
+    }
+    COUNT(move, 4);
+    COUNT(illegal, 4 - __builtin_popcount(m.legal));
+    return m;
+}
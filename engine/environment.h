@@ -0,0 +1,34 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include "rule.h"
+
+/**
+ * the placement of the environment, with the tile bag and the spawn edge as policies (see rule.h)
+ *
+ * the state of the bag is kept by the caller, e.g. the thread_local bag of the agents
+ */
+template<class bag_rule, class edge_rule>
+class basic_env {
+public:
+    typedef bag_rule bag_type;
+    typedef edge_rule edge_type;
+
+    /**
+     * draw the next tile from the bag, and a random empty cell of the spawn edge after slide op
+     * return false if the edge has no empty cell, where the tile is still taken from the bag
+     */
+    template<class board, class engine>
+    static bool spawn(const board& after, int op, std::vector<typename board::cell>& bag, engine& rng,
+                      unsigned& pos, typename board::cell& tile) {
+        tile = bag_rule::next(bag, rng);
+        std::vector<int> space = edge_rule::space(op);
+        std::shuffle(space.begin(), space.end(), rng);
+        for (int p : space) {
+            if (after(p) != 0) continue;
+            pos = p;
+            return true;
+        }
+        return false;
+    }
+};
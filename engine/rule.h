@@ -0,0 +1,108 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * compile-time rules of the threes-like variants, given as policies to basic_board and basic_env
+ *
+ * a reward rule defines
+ *   score             the integer type of the reward of a line in the lookup table
+ *   pair()            the reward of merging 1 and 2 into 3
+ *   merge(t)          the reward of merging two equal tiles into tile t
+ * a bag rule defines
+ *   next(bag, engine) the next tile drawn from the bag, refilled and shuffled when it is empty
+ *   full, draw(bag, engine)
+ *                     the same bag kept as a bitmask of the tiles left (bit t - 1 for tile t),
+ *                     for the fast paths which keep their own bags (e.g. batch.h, perft.h)
+ * an edge rule defines
+ *   space(op)         the cells where a tile may be placed after slide op (-1 before the first slide)
+ *   mask(op)          the same cells as a bitmask (bit i for cell i)
+ */
+namespace rule {
+
+/**
+ * the reward of hw1, 4 for 1+2 and the square of the merged tile index
+ */
+struct square_reward {
+    typedef int16_t score;
+    static int pair() { return 4; }
+    static int merge(unsigned t) { return t * t; }
+};
+
+/**
+ * the reward of hw2, 2 for 1+2 and the merged tile index
+ */
+struct linear_reward {
+    typedef int8_t score;
+    static int pair() { return 2; }
+    static int merge(unsigned t) { return t; }
+};
+
+/**
+ * the bitmask form of the bag of tiles 1, 2 and 3, a tile left is drawn uniformly
+ */
+struct tile_bag {
+    static constexpr unsigned full = 0b111;
+
+    template<typename engine>
+    static unsigned draw(unsigned& bag, engine& rng) {
+        if (!bag) bag = full;
+        unsigned t = bag, k = rng() % __builtin_popcount(bag);
+        while (k--) t &= t - 1;
+        t = __builtin_ctz(t);
+        bag &= ~(1u << t);
+        return t + 1;
+    }
+};
+
+/**
+ * the bag of tiles 1, 2 and 3, shuffled with the random engine of the environment
+ */
+struct engine_bag : tile_bag {
+    template<typename cell, typename engine>
+    static cell next(std::vector<cell>& bag, engine& rng) {
+        if (bag.empty()) {
+            for (int i = 1; i <= 3; i++)
+                bag.push_back(i);
+            std::shuffle(bag.begin(), bag.end(), rng);
+        }
+        cell tile = bag.back();
+        bag.pop_back();
+        return tile;
+    }
+};
+
+/**
+ * the bag of tiles 1, 2 and 3, shuffled with std::random_shuffle (the global rand) as hw1 does
+ */
+struct rand_bag : tile_bag {
+    template<typename cell, typename engine>
+    static cell next(std::vector<cell>& bag, engine&) {
+        if (bag.empty()) {
+            for (int i = 1; i <= 3; i++)
+                bag.push_back(i);
+            std::random_shuffle(bag.begin(), bag.end());
+        }
+        cell tile = bag.back();
+        bag.pop_back();
+        return tile;
+    }
+};
+
+/**
+ * the edge opposite to the last slide, or the whole board before the first slide
+ */
+struct opposite_edge {
+    static uint16_t mask(int op) {
+        static const uint16_t edge[5] = { 0xf000, 0x1111, 0x000f, 0x8888, 0xffff }; // up, right, down, left, none
+        return edge[op >= 0 && op < 4 ? op : 4];
+    }
+    static std::vector<int> space(int op) {
+        std::vector<int> cells;
+        for (unsigned m = mask(op); m; m &= m - 1) cells.push_back(__builtin_ctz(m));
+        return cells;
+    }
+};
+
+} // namespace rule
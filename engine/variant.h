@@ -0,0 +1,21 @@
+#pragma once
+#include "rule.h"
+#include "board.h"
+#include "environment.h"
+
+/**
+ * the rules of the homework variants, each a board and an environment built from the shared engine
+ */
+namespace variant {
+
+struct hw1 {
+    typedef basic_board<rule::square_reward> board;
+    typedef basic_env<rule::rand_bag, rule::opposite_edge> environment;
+};
+
+struct hw2 {
+    typedef basic_board<rule::linear_reward> board;
+    typedef basic_env<rule::engine_bag, rule::opposite_edge> environment;
+};
+
+} // namespace variant